@@ -0,0 +1,143 @@
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+#ifndef THEMET_BOUNDEDQUEUE_H
+#define THEMET_BOUNDEDQUEUE_H
+
+/**
+ * A fixed-capacity, lock-free queue between exactly one producer thread and one consumer thread
+ *
+ * A full queue makes the producer wait and an empty one makes the consumer wait, so a
+ * chain of these queues limits how far a fast stage of a pipeline can run ahead of a
+ * slow one. Waiting threads sleep until the other side moves, so a stage that is
+ * starved or blocked doesn't keep a core busy.
+ * @tparam T The element type
+ */
+template<typename T>
+class BoundedQueue
+{
+private:
+    std::vector<T> _slots;
+    std::size_t _mask;
+
+    // The consumer owns _head and the producer owns _tail; keep them on separate cache lines
+    alignas(64) std::atomic<std::size_t> _head;
+    alignas(64) std::atomic<std::size_t> _tail;
+
+    // Bumped by every change a waiting thread may be waiting for, which is what it waits on
+    alignas(64) std::atomic<std::uint32_t> _events;
+
+    std::atomic<bool> _closed;
+    std::atomic<bool> _cancelled;
+
+    void signal()
+    {
+        _events.fetch_add(1, std::memory_order_release);
+        _events.notify_all();
+    }
+
+public:
+    /**
+     * Create a queue
+     * @param capacity The minimum number of elements the queue holds before push() waits
+     */
+    explicit BoundedQueue(std::size_t capacity) : _head(0), _tail(0), _events(0), _closed(false), _cancelled(false)
+    {
+        std::size_t size = 1;
+        while (size < capacity)
+            size <<= 1;
+
+        _slots.resize(size);
+        _mask = size - 1;
+    }
+
+    BoundedQueue(const BoundedQueue &) = delete;
+
+    BoundedQueue &operator=(const BoundedQueue &) = delete;
+
+    /**
+     * Add an element to the back of the queue, waiting while it is full. Only the producer may call this
+     * @param value The element
+     * @return False if the queue was cancelled
+     */
+    bool push(T value)
+    {
+        auto tail = _tail.load(std::memory_order_relaxed);
+
+        while (true)
+        {
+            // Read the events first, so a pop after the check below still wakes the wait
+            auto events = _events.load(std::memory_order_acquire);
+
+            if (tail - _head.load(std::memory_order_acquire) != _slots.size())
+                break;
+
+            if (_cancelled.load(std::memory_order_relaxed))
+                return false;
+
+            _events.wait(events, std::memory_order_acquire);
+        }
+
+        _slots[tail & _mask] = std::move(value);
+        _tail.store(tail + 1, std::memory_order_release);
+        signal();
+        return true;
+    }
+
+    /**
+     * Remove the element at the front of the queue, waiting while it is empty. Only the consumer may call this
+     * @param value Set to the element
+     * @return False if the queue was closed and is empty, or was cancelled
+     */
+    bool pop(T &value)
+    {
+        auto head = _head.load(std::memory_order_relaxed);
+
+        while (true)
+        {
+            // Read the events first, so a push, close or cancel after the checks below still wakes the wait
+            auto events = _events.load(std::memory_order_acquire);
+
+            if (head != _tail.load(std::memory_order_acquire))
+                break;
+
+            if (_cancelled.load(std::memory_order_relaxed))
+                return false;
+
+            // Everything pushed before close() is visible once the close is
+            if (_closed.load(std::memory_order_acquire) && head == _tail.load(std::memory_order_acquire))
+                return false;
+
+            _events.wait(events, std::memory_order_acquire);
+        }
+
+        value = std::move(_slots[head & _mask]);
+        _head.store(head + 1, std::memory_order_release);
+        signal();
+        return true;
+    }
+
+    /**
+     * Signal that nothing more will be pushed. Only the producer may call this
+     */
+    void close()
+    {
+        _closed.store(true, std::memory_order_release);
+        signal();
+    }
+
+    /**
+     * Make all current and future push() and pop() calls fail, e.g. because another stage failed.
+     * Any thread may call this
+     */
+    void cancel()
+    {
+        _cancelled.store(true, std::memory_order_relaxed);
+        signal();
+    }
+};
+
+#endif //THEMET_BOUNDEDQUEUE_H
@@ -0,0 +1,80 @@
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include "csv.h"
+
+#ifndef THEMET_COMPARATORKERNELS_H
+#define THEMET_COMPARATORKERNELS_H
+
+/*
+ * Kernels that test one key against a run of up to 64 keys at once, for the comparators'
+ * batch interface. Each returns a mask with bit i set if keys[i] passes, i.e. if the
+ * scalar comparator wouldn't reject the pair for costing more than maxCost.
+ *
+ * Like the scanners of csv.h, they use SIMD with CSV_IO_SIMD (GCC or Clang on x86-64,
+ * unless CSV_IO_NO_SIMD is defined): they compare 8 keys at a time with AVX2 when the
+ * CPU supports it, or 4 with SSE2.
+ */
+namespace comparator_kernels
+{
+    constexpr std::size_t batchSize = 64;
+
+#ifdef CSV_IO_SIMD
+
+    inline std::uint64_t withinDistanceSse2(float key, const float *keys, std::size_t count, float maxCost, std::size_t &done)
+    {
+        const __m128 vkey = _mm_set1_ps(key), vmax = _mm_set1_ps(maxCost), vabs = _mm_castsi128_ps(_mm_set1_epi32(0x7FFFFFFF));
+        std::uint64_t mask = 0;
+
+        for (done = 0; count - done >= 4; done += 4)
+        {
+            __m128 cost = _mm_and_ps(_mm_sub_ps(vkey, _mm_loadu_ps(keys + done)), vabs);
+            mask |= (std::uint64_t) _mm_movemask_ps(_mm_cmpngt_ps(cost, vmax)) << done;
+        }
+
+        return mask;
+    }
+
+    __attribute__((target("avx2"))) inline std::uint64_t withinDistanceAvx2(float key, const float *keys, std::size_t count, float maxCost, std::size_t &done)
+    {
+        const __m256 vkey = _mm256_set1_ps(key), vmax = _mm256_set1_ps(maxCost), vabs = _mm256_castsi256_ps(_mm256_set1_epi32(0x7FFFFFFF));
+        std::uint64_t mask = 0;
+
+        for (done = 0; count - done >= 8; done += 8)
+        {
+            __m256 cost = _mm256_and_ps(_mm256_sub_ps(vkey, _mm256_loadu_ps(keys + done)), vabs);
+            mask |= (std::uint64_t) _mm256_movemask_ps(_mm256_cmp_ps(cost, vmax, _CMP_NGT_UQ)) << done;
+        }
+
+        return mask;
+    }
+
+#endif
+
+    /**
+     * Tests which keys are within {maxCost} of a key, the way fabs(key - keys[i]) > maxCost
+     * rejects them (so a NaN distance passes)
+     * @param key The key to compare against
+     * @param keys The keys to test
+     * @param count The number of keys, at most batchSize
+     * @param maxCost The maximum distance allowed
+     * @return A mask with bit i set if keys[i] passes
+     */
+    inline std::uint64_t withinDistance(float key, const float *keys, std::size_t count, float maxCost)
+    {
+        std::size_t done = 0;
+        std::uint64_t mask = 0;
+
+#ifdef CSV_IO_SIMD
+        mask = io::detail::has_avx2() ? withinDistanceAvx2(key, keys, count, maxCost, done) : withinDistanceSse2(key, keys, count, maxCost, done);
+#endif
+
+        for (; done < count; ++done)
+            if (!(std::fabs(key - keys[done]) > maxCost))
+                mask |= (std::uint64_t) 1 << done;
+
+        return mask;
+    }
+}
+
+#endif //THEMET_COMPARATORKERNELS_H
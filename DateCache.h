@@ -0,0 +1,122 @@
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include "MuseumObject.h"
+
+#ifndef THEMET_DATECACHE_H
+#define THEMET_DATECACHE_H
+
+/**
+ * Memoizes MuseumObjectDateComparator::getYear by the raw date string, remembering
+ * the dates it fails to parse as well as the years it finds
+ *
+ * The dataset has far fewer distinct dates than rows, so most rows cost one hash lookup.
+ * The table is split into shards, each with its own lock, so the loader's threads can
+ * share one cache without all waiting on the same lock.
+ */
+class DateCache
+{
+public:
+    struct Counts
+    {
+        std::uint64_t hits = 0;
+        std::uint64_t misses = 0;
+        std::uint64_t entries = 0;
+    };
+
+private:
+    static constexpr std::size_t shardCount = 16;
+
+    struct Hash
+    {
+        typedef void is_transparent;
+
+        std::size_t operator()(std::string_view s) const
+        {
+            return std::hash<std::string_view>()(s);
+        }
+    };
+
+    // An empty year means the date couldn't be parsed
+    typedef std::unordered_map<std::string, std::optional<float>, Hash, std::equal_to<>> Map;
+
+    struct alignas(64) Shard
+    {
+        std::mutex lock;
+        Map years;
+        std::uint64_t hits = 0;
+        std::uint64_t misses = 0;
+    };
+
+    Shard _shards[shardCount];
+
+public:
+    DateCache() = default;
+
+    DateCache(const DateCache &) = delete;
+
+    DateCache &operator=(const DateCache &) = delete;
+
+    /**
+     * Converts a date to a year, parsing it only the first time the date is seen
+     * @param date The date, as it appears in the dataset
+     * @return Optionally, the year, or nothing if the date can't be parsed
+     */
+    std::optional<float> getYear(std::string_view date)
+    {
+        auto hash = Hash()(date);
+        auto &shard = _shards[hash % shardCount];
+
+        {
+            std::lock_guard<std::mutex> guard(shard.lock);
+            auto it = shard.years.find(date);
+            if (it != shard.years.end())
+            {
+                ++shard.hits;
+                return it->second;
+            }
+        }
+
+        // Parse outside of the lock; if another thread parses the same date meanwhile,
+        // both get the same year and the second insert is a no-op
+        std::optional<float> year;
+        try
+        {
+            year = MuseumObjectDateComparator::getYear(date);
+        }
+        catch (std::invalid_argument &e)
+        {
+        }
+
+        std::lock_guard<std::mutex> guard(shard.lock);
+        ++shard.misses;
+        shard.years.emplace(date, year);
+        return year;
+    }
+
+    /**
+     * Gets the number of lookups that did and didn't find their date, and the number of distinct dates
+     */
+    [[nodiscard]] Counts counts()
+    {
+        Counts counts;
+
+        for (auto &shard: _shards)
+        {
+            std::lock_guard<std::mutex> guard(shard.lock);
+            counts.hits += shard.hits;
+            counts.misses += shard.misses;
+            counts.entries += shard.years.size();
+        }
+
+        return counts;
+    }
+};
+
+#endif //THEMET_DATECACHE_H
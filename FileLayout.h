@@ -0,0 +1,38 @@
+#include <cstdint>
+#include <limits>
+
+#ifndef THEMET_FILELAYOUT_H
+#define THEMET_FILELAYOUT_H
+
+/**
+ * Adds up the sizes of the sections of a binary file, remembering if they overflow
+ *
+ * The counts of a file's sections come from its header, which can't be trusted, so the
+ * offsets are computed with checked arithmetic: corrupt counts can't wrap around to the
+ * size of the file.
+ */
+struct FileLayout
+{
+    std::uint64_t size;
+    bool overflowed = false;
+
+    /**
+     * Appends a section
+     * @param count The number of elements in the section
+     * @param elementSize The size of each element
+     * @return The offset of the section
+     */
+    std::uint64_t add(std::uint64_t count, std::uint64_t elementSize)
+    {
+        auto offset = size;
+
+        if (count > (std::numeric_limits<std::uint64_t>::max() - size) / elementSize)
+            overflowed = true;
+        else
+            size += count * elementSize;
+
+        return offset;
+    }
+};
+
+#endif //THEMET_FILELAYOUT_H
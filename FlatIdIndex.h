@@ -0,0 +1,156 @@
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <optional>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#ifndef THEMET_FLATIDINDEX_H
+#define THEMET_FLATIDINDEX_H
+
+/**
+ * Maps object IDs to dense 32-bit indices with an open-addressing hash table
+ *
+ * The table is one flat array of slots probed linearly, each holding an index and the
+ * hash of its ID, so a lookup usually touches one cache line and compares a single ID.
+ * The IDs themselves aren't stored: whoever owns them passes keyOf, which gets the ID
+ * of an index, to every call that compares IDs. Lookups never insert.
+ */
+class FlatIdIndex
+{
+private:
+    static constexpr std::uint32_t noIndex = std::numeric_limits<std::uint32_t>::max();
+
+    struct slot
+    {
+        std::uint32_t hash;
+        std::uint32_t index = noIndex;
+    };
+
+    std::vector<slot> _slots;
+    std::size_t _size = 0;
+
+    static std::uint32_t hashOf(std::string_view id)
+    {
+        auto hash = (std::uint64_t) std::hash<std::string_view>()(id);
+        return (std::uint32_t) (hash ^ hash >> 32);
+    }
+
+    std::size_t mask() const
+    {
+        return _slots.size() - 1;
+    }
+
+    /**
+     * Gets the slot holding an ID, or the empty slot where it would go
+     */
+    template<typename KeyOf>
+    std::size_t probe(std::string_view id, std::uint32_t hash, KeyOf &keyOf) const
+    {
+        auto i = hash & mask();
+        while (_slots[i].index != noIndex && (_slots[i].hash != hash || keyOf(_slots[i].index) != id))
+            i = (i + 1) & mask();
+
+        return i;
+    }
+
+    void grow()
+    {
+        auto old = std::move(_slots);
+        _slots.assign(std::max<std::size_t>(16, old.size() * 2), slot());
+
+        for (const auto &s: old)
+            if (s.index != noIndex)
+            {
+                auto i = s.hash & mask();
+                while (_slots[i].index != noIndex)
+                    i = (i + 1) & mask();
+                _slots[i] = s;
+            }
+    }
+
+public:
+    FlatIdIndex() = default;
+
+    FlatIdIndex(const FlatIdIndex &) = default;
+
+    FlatIdIndex(FlatIdIndex &&other) noexcept : _slots(std::move(other._slots)), _size(std::exchange(other._size, 0))
+    {}
+
+    FlatIdIndex &operator=(const FlatIdIndex &) = default;
+
+    FlatIdIndex &operator=(FlatIdIndex &&other) noexcept
+    {
+        _slots = std::move(other._slots);
+        _size = std::exchange(other._size, 0);
+        return *this;
+    }
+
+    /**
+     * Make room for a number of IDs without growing
+     * @param count The number of IDs
+     */
+    void reserve(std::size_t count)
+    {
+        // At most half of the slots are used, which keeps the probes short
+        while (_slots.size() < 2 * count)
+            grow();
+    }
+
+    [[nodiscard]] std::size_t size() const
+    {
+        return _size;
+    }
+
+    void clear()
+    {
+        _slots.clear();
+        _size = 0;
+    }
+
+    /**
+     * Gets the index of an ID
+     * @param id The ID
+     * @param keyOf Gets the ID of an index
+     * @return Optionally, the index if the ID is in the index
+     */
+    template<typename KeyOf>
+    std::optional<std::uint32_t> find(std::string_view id, KeyOf &&keyOf) const
+    {
+        if (_size == 0)
+            return {};
+
+        auto i = probe(id, hashOf(id), keyOf);
+        if (_slots[i].index == noIndex)
+            return {};
+
+        return _slots[i].index;
+    }
+
+    /**
+     * Adds an ID, unless it's already in the index
+     * @param id The ID
+     * @param index The index of the ID
+     * @param keyOf Gets the ID of an index
+     * @return Whether the ID was added. If not, it keeps its index
+     */
+    template<typename KeyOf>
+    bool insert(std::string_view id, std::uint32_t index, KeyOf &&keyOf)
+    {
+        if (2 * (_size + 1) > _slots.size())
+            grow();
+
+        auto hash = hashOf(id);
+        auto i = probe(id, hash, keyOf);
+        if (_slots[i].index != noIndex)
+            return false;
+
+        _slots[i] = {hash, index};
+        ++_size;
+        return true;
+    }
+};
+
+#endif //THEMET_FLATIDINDEX_H
@@ -0,0 +1,208 @@
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <initializer_list>
+#include <vector>
+#include "csr_graph.h"
+#include "graph.h"
+#include "MuseumObject.h"
+#include "MuseumObjectGrouper.h"
+#include "ObjectTable.h"
+
+#ifndef THEMET_GRAPHESTIMATOR_H
+#define THEMET_GRAPHESTIMATOR_H
+
+/**
+ * Predicts how many edges fillGraph would insert and how much memory the csr_graph
+ * would take, without building it
+ *
+ * Grouping by artist or location relates every pair in a bucket, so the edges are
+ * counted exactly from the bucket sizes. Grouping by date relates the pairs within
+ * {maxCost} years, which are counted from a histogram of the dates convolved with a
+ * window {maxCost} wide. Grouping by several criteria at once can't relate more pairs
+ * than any of its criteria alone, so it is bounded by the smallest of their estimates.
+ */
+class GraphEstimator
+{
+public:
+    struct Estimate
+    {
+        // Directed edges, i.e. each related pair counts twice, as the graph stores it
+        std::uint64_t edges = 0;
+
+        // Objects with at least one edge
+        std::uint64_t vertices = 0;
+
+        // The memory the graph would take, including building it
+        std::uint64_t bytes = 0;
+    };
+
+    /**
+     * Estimate the graph fillGraph builds with a grouping method
+     * @param groupingMethod The method by which to score pairs
+     * @param objects The museum objects
+     * @return The estimate, which is empty for unknown methods
+     */
+    static Estimate estimate(int groupingMethod, const ObjectTable &objects)
+    {
+        Estimate estimate;
+
+        switch (groupingMethod)
+        {
+            case 1:
+                estimate = countDatePairs(objects.dates(), dateMaxCost);
+                break;
+            case 2:
+                estimate = countBucketPairs(objects.artistIds());
+                break;
+            case 3:
+                estimate = countBucketPairs(objects.countryIds());
+                break;
+            case 4:
+                estimate = smallest({countDatePairs(objects.dates(), dateMaxCost), countBucketPairs(objects.artistIds()), countBucketPairs(objects.countryIds())});
+                break;
+            default:
+                return {};
+        }
+
+        estimate.bytes = bytesOf(estimate, objects);
+        return estimate;
+    }
+
+    /**
+     * Estimate the graph fillKnnGraph builds, which is bounded by the number of neighbors
+     * @param objects The museum objects
+     * @param k The number of neighbors to keep per object
+     * @return The estimate
+     */
+    static Estimate estimateKnn(const ObjectTable &objects, unsigned k)
+    {
+        Estimate estimate;
+        estimate.vertices = k ? objects.size() : 0;
+        estimate.edges = 2ull * k * objects.size();
+        estimate.bytes = bytesOf(estimate, objects);
+        return estimate;
+    }
+
+    /**
+     * Finds the most neighbors per object a k-NN graph can keep within a memory budget
+     * @param objects The museum objects
+     * @param budget The memory budget, in bytes
+     * @param maxK The most neighbors to keep
+     * @return The number of neighbors, or 0 if not even one fits
+     */
+    static unsigned knnWithin(const ObjectTable &objects, std::uint64_t budget, unsigned maxK)
+    {
+        for (auto k = maxK; k > 0; --k)
+            if (estimateKnn(objects, k).bytes <= budget)
+                return k;
+
+        return 0;
+    }
+
+private:
+    /**
+     * Count the pairs of objects with equal keys
+     */
+    static Estimate countBucketPairs(const std::vector<std::uint32_t> &keys)
+    {
+        Estimate estimate;
+        if (keys.empty())
+            return estimate;
+
+        std::vector<std::uint64_t> bucketSize((std::size_t) *std::max_element(keys.begin(), keys.end()) + 1, 0);
+        for (auto key: keys)
+            ++bucketSize[key];
+
+        for (auto size: bucketSize)
+            if (size > 1)
+            {
+                estimate.edges += size * (size - 1);
+                estimate.vertices += size;
+            }
+
+        return estimate;
+    }
+
+    /**
+     * Count the pairs of objects whose dates are within {maxCost} of each other
+     *
+     * The dates are binned by year, and every bin is related to the bins within {maxCost}
+     * years of it, which is exact for dates that are whole years (as getYear returns). Very
+     * wide ranges of dates are binned more coarsely, which overestimates.
+     */
+    static Estimate countDatePairs(const std::vector<float> &dates, float maxCost)
+    {
+        constexpr double maxBins = 1 << 24;
+
+        Estimate estimate;
+        if (dates.empty())
+            return estimate;
+
+        auto [lowest, highest] = std::minmax_element(dates.begin(), dates.end());
+        double low = std::floor(*lowest), range = std::floor(*highest) - low + 1;
+
+        double width = std::max(1.0, std::ceil(range / maxBins));
+        auto bins = (std::size_t) std::ceil(range / width);
+        auto radius = (std::size_t) std::ceil(std::floor(maxCost) / width);
+
+        // The running total of the histogram, so any window of bins is one subtraction
+        std::vector<std::uint64_t> total(bins + 1, 0);
+        for (auto date: dates)
+            ++total[std::min(bins - 1, (std::size_t) ((std::floor(date) - low) / width)) + 1];
+        for (std::size_t bin = 0; bin < bins; ++bin)
+            total[bin + 1] += total[bin];
+
+        for (std::size_t bin = 0; bin < bins; ++bin)
+        {
+            auto count = total[bin + 1] - total[bin];
+            if (count == 0)
+                continue;
+
+            auto window = total[std::min(bins, bin + radius + 1)] - total[bin >= radius ? bin - radius : 0];
+            if (window > 1)
+            {
+                estimate.edges += count * (window - 1);
+                estimate.vertices += count;
+            }
+        }
+
+        return estimate;
+    }
+
+    static Estimate smallest(std::initializer_list<Estimate> estimates)
+    {
+        Estimate smallest = *estimates.begin();
+
+        for (const auto &estimate: estimates)
+        {
+            smallest.edges = std::min(smallest.edges, estimate.edges);
+            smallest.vertices = std::min(smallest.vertices, estimate.vertices);
+        }
+
+        return smallest;
+    }
+
+    /**
+     * Estimate the memory of a graph from its edge and vertex counts
+     *
+     * The graph stores each directed edge as a neighbor, and each vertex as its row and
+     * the offset of its neighbors. While it is built, the grouper also holds every edge
+     * twice, in the buffer of its task and in the list they're concatenated into, and the
+     * graph indexes the vertices by row.
+     */
+    static std::uint64_t bytesOf(const Estimate &estimate, const ObjectTable &objects)
+    {
+        if (objects.empty())
+            return 0;
+
+        auto edgeBytes = sizeof(csr_graph::neighbor);
+        auto vertexBytes = 2 * sizeof(std::uint32_t) + 2 * sizeof(std::uint64_t);
+        auto buildBytes = sizeof(graph::edge);
+
+        return (std::uint64_t) (estimate.edges * (edgeBytes + buildBytes) + estimate.vertices * vertexBytes + objects.size() * sizeof(csr_graph::vertex_type));
+    }
+};
+
+#endif //THEMET_GRAPHESTIMATOR_H
@@ -0,0 +1,309 @@
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "csr_graph.h"
+#include "csv.h"
+#include "FileLayout.h"
+#include "MuseumObjectGrouper.h"
+#include "ObjectTable.h"
+
+#ifndef THEMET_GRAPHFILE_H
+#define THEMET_GRAPHFILE_H
+
+/**
+ * Caches the graph grouped from a dataset in a binary file next to it, so later runs
+ * can map it into memory instead of grouping the objects again
+ *
+ * A graph file is keyed on a hash of the objects it was grouped from (after any deltas),
+ * the grouping method, its maximum cost and the number of neighbors kept per object (0
+ * for the complete graph). A graph file whose key doesn't match is rebuilt.
+ *
+ * The graph file holds the arrays of a csr_graph as they are laid out in memory, in host
+ * byte order, and the graph refers to them where they are mapped:
+ * <ol>
+ *     <li>Header</li>
+ *     <li>The row of each vertex, padded to a multiple of 8 bytes</li>
+ *     <li>The offset of each vertex's neighbors, followed by the number of neighbors</li>
+ *     <li>The neighbors</li>
+ * </ol>
+ */
+class GraphFile
+{
+public:
+    struct Key
+    {
+        int groupingMethod;
+
+        // The neighbors kept per object, or 0 for the complete graph
+        unsigned neighbors;
+    };
+
+    /**
+     * Gets the graph file of a dataset for a key
+     * @param datasetPath The path to the CSV dataset
+     * @param key How the graph is grouped
+     * @return The path of the graph file
+     */
+    static std::string pathFor(const std::string &datasetPath, const Key &key)
+    {
+        auto path = datasetPath + ".graph" + std::to_string(key.groupingMethod);
+        if (key.neighbors > 0)
+            path += "-knn" + std::to_string(key.neighbors);
+
+        return path;
+    }
+
+    /**
+     * Load a graph from its graph file, (re)building the graph and its file first if needed
+     * @param graph The graph to replace
+     * @param datasetPath The path to the CSV dataset the objects were loaded from
+     * @param key How the graph is grouped
+     * @param objects The objects, which must outlive the graph
+     * @param rebuild True to rebuild the graph file even if it is up to date
+     * @param build Called as build(graph) to group the objects into the graph, returning whether it could
+     * @return Whether the graph was loaded or built
+     */
+    template<typename F>
+    static bool loadOrBuild(csr_graph &graph, const std::string &datasetPath, const Key &key, const ObjectTable &objects, bool rebuild, F &&build)
+    {
+#ifdef CSV_IO_MMAP
+        auto graphPath = pathFor(datasetPath, key);
+        auto tableHash = hashTable(objects);
+
+        if (!rebuild && tryLoad(graphPath, key, tableHash, objects, graph))
+            return true;
+
+        if (!build(graph))
+            return false;
+
+        write(graphPath, key, tableHash, objects, graph);
+        return true;
+#else
+        return build(graph);
+#endif
+    }
+
+    /**
+     * Load a graph from its graph file, if it is up to date, without building it otherwise
+     * @param graph The graph to replace
+     * @param datasetPath The path to the CSV dataset the objects were loaded from
+     * @param key How the graph is grouped
+     * @param objects The objects, which must outlive the graph
+     * @return Whether the graph was loaded
+     */
+    static bool load(csr_graph &graph, const std::string &datasetPath, const Key &key, const ObjectTable &objects)
+    {
+        return tryLoad(pathFor(datasetPath, key), key, hashTable(objects), objects, graph);
+    }
+
+private:
+    static constexpr char magic[8] = {'M', 'E', 'T', 'G', 'R', 'A', 'P', 'H'};
+
+    // Bump whenever the layout or the way objects are grouped changes
+    static constexpr std::uint32_t version = 1;
+
+    struct Header
+    {
+        char magic[8];
+        std::uint32_t version;
+        std::int32_t groupingMethod;
+        float maxCost;
+        std::uint32_t neighbors;
+        std::uint64_t tableHash;
+        std::uint64_t rowCount;
+        std::uint64_t vertexCount;
+        std::uint64_t edgeCount;
+    };
+
+    static_assert(sizeof(Header) % 8 == 0, "The arrays after the header must stay aligned");
+
+    static std::size_t pad(std::size_t length)
+    {
+        return (length + 7) & ~(std::size_t) 7;
+    }
+
+    static std::uint64_t hashBytes(std::uint64_t hash, const void *bytes, std::size_t size)
+    {
+        auto data = static_cast<const unsigned char *>(bytes);
+
+        for (std::size_t i = 0; i < size; ++i)
+            hash = (hash ^ data[i]) * 0x100000001b3ull;
+
+        return hash;
+    }
+
+    /**
+     * Hashes what grouping looks at: the objects' IDs and the columns of the comparators
+     * @param objects The objects
+     * @return The hash
+     */
+    static std::uint64_t hashTable(const ObjectTable &objects)
+    {
+        std::uint64_t hash = 0xcbf29ce484222325ull ^ objects.size();
+
+        for (auto row: objects)
+        {
+            auto id = row.objectId();
+            auto length = (std::uint32_t) id.size();
+            hash = hashBytes(hash, &length, sizeof(length));
+            hash = hashBytes(hash, id.data(), id.size());
+        }
+
+        hash = hashBytes(hash, objects.dates().data(), objects.size() * sizeof(float));
+        hash = hashBytes(hash, objects.artistIds().data(), objects.size() * sizeof(std::uint32_t));
+        hash = hashBytes(hash, objects.countryIds().data(), objects.size() * sizeof(std::uint32_t));
+
+        return hash;
+    }
+
+    /**
+     * Map a graph from its graph file if it is valid and matches the objects
+     * @param graphPath The graph file
+     * @param key How the graph is grouped
+     * @param tableHash The hash of the objects
+     * @param objects The objects
+     * @param graph The graph to replace
+     * @return True if the graph was loaded
+     */
+    static bool tryLoad(const std::string &graphPath, const Key &key, std::uint64_t tableHash, const ObjectTable &objects, csr_graph &graph)
+    {
+#ifdef CSV_IO_MMAP
+        // Searches jump all over the neighbors, so don't read ahead as if they didn't
+        std::shared_ptr<const io::detail::MappedFile> mapping = io::detail::MappedFile::open(graphPath.c_str(), false);
+        if (!mapping || mapping->size() < sizeof(Header))
+            return false;
+
+        auto data = mapping->data();
+
+        Header header{};
+        std::memcpy(&header, data, sizeof(Header));
+
+        if (std::memcmp(header.magic, magic, sizeof(magic)) != 0 || header.version != version)
+            return false;
+
+        if (header.groupingMethod != key.groupingMethod || header.neighbors != key.neighbors || header.maxCost != groupingMaxCost(key.groupingMethod))
+            return false;
+
+        if (header.tableHash != tableHash || header.rowCount != objects.size())
+            return false;
+
+        // Every vertex is a row, which also bounds the padding of the vertex table below
+        auto vertices = header.vertexCount;
+        if (vertices > header.rowCount)
+            return false;
+
+        // Lay the arrays out with checked arithmetic, so corrupt counts can't wrap around to the file's size
+        FileLayout layout{sizeof(Header)};
+        layout.add(pad(vertices * sizeof(std::uint32_t)), 1);
+        auto offsetsOffset = layout.add(vertices + 1, sizeof(std::uint64_t));
+        auto neighborsOffset = layout.add(header.edgeCount, sizeof(csr_graph::neighbor));
+
+        if (layout.overflowed || layout.size != mapping->size())
+            return false;
+
+        std::span rows(reinterpret_cast<const std::uint32_t *>(data + sizeof(Header)), vertices);
+        std::span offsets(reinterpret_cast<const std::uint64_t *>(data + offsetsOffset), vertices + 1);
+        std::span neighbors(reinterpret_cast<const csr_graph::neighbor *>(data + neighborsOffset), header.edgeCount);
+
+        // Check that no row, offset or neighbor leads out of bounds, and that searches
+        // won't compare NaN weights. This reads the whole file once, which is still far
+        // cheaper than grouping the objects again
+        for (auto row: rows)
+            if (row >= objects.size())
+                return false;
+
+        if (offsets.front() != 0 || offsets.back() != header.edgeCount)
+            return false;
+
+        for (std::size_t v = 0; v < vertices; ++v)
+            if (offsets[v] > offsets[v + 1])
+                return false;
+
+        for (const auto &n: neighbors)
+            if (n.vertex >= vertices || std::isnan(n.weight))
+                return false;
+
+        csr_graph mapped;
+        mapped._objects = &objects;
+        mapped._rows = rows;
+        mapped._offsets = offsets;
+        mapped._neighbors = neighbors;
+        mapped._mapping = std::move(mapping);
+        mapped.indexVertices();
+
+        graph = std::move(mapped);
+        return true;
+#else
+        return false;
+#endif
+    }
+
+    /**
+     * Write a graph file, replacing any existing one only once it has been written completely.
+     * Failing to write a graph file (e.g. in a read-only directory) isn't an error, it
+     * just means the next run has to group the objects again
+     * @param graphPath The graph file
+     * @param key How the graph is grouped
+     * @param tableHash The hash of the objects
+     * @param objects The objects
+     * @param graph The graph grouped from the objects
+     */
+    static void write(const std::string &graphPath, const Key &key, std::uint64_t tableHash, const ObjectTable &objects, const csr_graph &graph)
+    {
+        Header header{};
+        std::memcpy(header.magic, magic, sizeof(magic));
+        header.version = version;
+        header.groupingMethod = key.groupingMethod;
+        header.maxCost = groupingMaxCost(key.groupingMethod);
+        header.neighbors = key.neighbors;
+        header.tableHash = tableHash;
+        header.rowCount = objects.size();
+        header.vertexCount = graph._rows.size();
+        header.edgeCount = graph._neighbors.size();
+
+        // An empty graph has no offsets of its own
+        std::vector<std::uint64_t> noOffsets{0};
+        auto offsets = graph._offsets.empty() ? std::span<const std::uint64_t>(noOffsets) : graph._offsets;
+
+        auto temporaryPath = graphPath + ".tmp";
+
+        {
+            std::ofstream file(temporaryPath, std::ios::binary | std::ios::trunc);
+            if (!file)
+                return;
+
+            auto writeArray = [&](const auto &array)
+            {
+                file.write(reinterpret_cast<const char *>(array.data()), (std::streamsize) array.size_bytes());
+            };
+
+            const char padding[8] = {};
+
+            file.write(reinterpret_cast<const char *>(&header), sizeof(Header));
+            writeArray(graph._rows);
+            file.write(padding, (std::streamsize) (pad(graph._rows.size_bytes()) - graph._rows.size_bytes()));
+            writeArray(offsets);
+            writeArray(graph._neighbors);
+
+            if (!file)
+            {
+                file.close();
+                std::remove(temporaryPath.c_str());
+                return;
+            }
+        }
+
+        std::error_code error;
+        std::filesystem::rename(temporaryPath, graphPath, error);
+    }
+};
+
+#endif //THEMET_GRAPHFILE_H
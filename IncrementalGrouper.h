@@ -0,0 +1,173 @@
+#include <algorithm>
+#include <cstdint>
+#include <limits>
+#include <string>
+#include <string_view>
+#include <unordered_set>
+#include <vector>
+#include "csr_graph.h"
+#include "MuseumObjectGrouper.h"
+#include "ObjectTable.h"
+
+#ifndef THEMET_INCREMENTALGROUPER_H
+#define THEMET_INCREMENTALGROUPER_H
+
+/**
+ * Patches the csr_graph grouped from a table of objects into the one fillGraph would
+ * group from the table once deltas have changed some of its objects, rather than
+ * grouping the whole table again
+ *
+ * Only the vertices of changed objects, and the vertices they were or are now related
+ * to, are grouped again, through an implicit_graph of the updated table. Every other
+ * vertex keeps its neighbors, which are copied from the old graph and renumbered. So
+ * grouping takes time proportional to the changed objects and their edges, while
+ * indexing the updated table and copying the arrays take time linear in their size.
+ */
+class IncrementalGrouper
+{
+public:
+    /**
+     * Patch a graph into the graph of the updated table
+     * @tparam G The implicit_graph of the method {before} was grouped with
+     * @param before The graph grouped from the table before the deltas
+     * @param after The table after the deltas, which must outlive the patched graph
+     * @param grouped The implicit_graph of {after}
+     * @param changedIds The object number of every added, changed and removed object
+     * @return The graph fillGraph would group from {after}
+     */
+    template<typename G>
+    static csr_graph patch(const csr_graph &before, const ObjectTable &after, const G &grouped, const std::vector<std::string> &changedIds)
+    {
+        constexpr auto noVertex = std::numeric_limits<csr_graph::vertex_type>::max();
+
+        // A delta may change an object several times, and several deltas the same object
+        std::vector<std::string> changed(changedIds);
+        std::sort(changed.begin(), changed.end());
+        changed.erase(std::unique(changed.begin(), changed.end()), changed.end());
+
+        // The changed IDs, and the IDs whose neighbors they were or are now among
+        std::unordered_set<std::string_view> affected(changed.begin(), changed.end());
+        for (const auto &id: changed)
+        {
+            if (auto v = before.find(id))
+                before.forEachNeighbor(*v, [&](csr_graph::vertex_type neighbor, float)
+                {
+                    affected.insert(before.id(neighbor));
+                });
+
+            if (auto v = grouped.find(id))
+                grouped.forEachNeighbor(*v, [&](typename G::vertex_type neighbor, float)
+                {
+                    affected.insert(grouped.id(neighbor));
+                });
+        }
+
+        std::vector<std::string_view> affectedIds(affected.begin(), affected.end());
+        std::sort(affectedIds.begin(), affectedIds.end());
+
+        // The vertex in {grouped} of each patched vertex, and the vertex of {before} to copy
+        // its neighbors from, if it wasn't affected
+        std::vector<typename G::vertex_type> groupedVertices;
+        std::vector<csr_graph::vertex_type> copiedVertices;
+
+        std::vector<csr_graph::vertex_type> vertexOfBefore(before.vertexCount(), noVertex);
+        std::vector<csr_graph::vertex_type> vertexOfGrouped(after.size(), noVertex);
+
+        auto addVertex = [&](std::string_view id, csr_graph::vertex_type old, bool copy)
+        {
+            // Objects left without any edges aren't vertices
+            auto v = grouped.find(std::string(id));
+            if (!v)
+                return;
+
+            auto vertex = (csr_graph::vertex_type) groupedVertices.size();
+            if (old != noVertex)
+                vertexOfBefore[old] = vertex;
+            vertexOfGrouped[*v] = vertex;
+
+            groupedVertices.push_back(*v);
+            copiedVertices.push_back(copy ? old : noVertex);
+        };
+
+        // Number the vertices in the order of their IDs, like any csr_graph, by merging the
+        // affected IDs into the old vertices, which are already in that order
+        auto next = affectedIds.begin();
+        for (csr_graph::vertex_type v = 0; v < before.vertexCount(); ++v)
+        {
+            auto id = before.id(v);
+            for (; next != affectedIds.end() && *next < id; ++next)
+                addVertex(*next, noVertex, false);
+
+            if (next != affectedIds.end() && *next == id)
+            {
+                addVertex(id, v, false);
+                ++next;
+            }
+            else
+                addVertex(id, v, true);
+        }
+
+        for (; next != affectedIds.end(); ++next)
+            addVertex(*next, noVertex, false);
+
+        csr_graph patched;
+        patched._objects = &after;
+
+        auto &rows = patched._rowStorage;
+        auto &offsets = patched._offsetStorage;
+        auto &neighbors = patched._neighborStorage;
+
+        rows.reserve(groupedVertices.size());
+        offsets.reserve(groupedVertices.size() + 1);
+        neighbors.reserve(before.edgeCount());
+        offsets.push_back(0);
+
+        // Both graphs visit neighbors in order of ID, which renumbering them keeps
+        for (std::size_t v = 0; v < groupedVertices.size(); ++v)
+        {
+            rows.push_back(grouped.rowOf(groupedVertices[v]));
+
+            if (copiedVertices[v] != noVertex)
+                before.forEachNeighbor(copiedVertices[v], [&](csr_graph::vertex_type neighbor, float weight)
+                {
+                    neighbors.push_back({vertexOfBefore[neighbor], weight});
+                });
+            else
+                grouped.forEachNeighbor(groupedVertices[v], [&](typename G::vertex_type neighbor, float weight)
+                {
+                    neighbors.push_back({vertexOfGrouped[neighbor], weight});
+                });
+
+            offsets.push_back(neighbors.size());
+        }
+
+        neighbors.shrink_to_fit();
+
+        patched._rows = rows;
+        patched._offsets = offsets;
+        patched._neighbors = neighbors;
+        patched.indexVertices();
+
+        return patched;
+    }
+
+    /**
+     * Patch a graph into the graph of the updated table, for the grouping methods that
+     * have an implicit_graph
+     * @param groupingMethod The method {before} was grouped with
+     * @param dest The graph to replace
+     * @param before The graph grouped from the table before the deltas
+     * @param after The table after the deltas, which must outlive {dest}
+     * @param changedIds The object number of every added, changed and removed object
+     * @return Whether the method can be patched. Composite methods can only be grouped again
+     */
+    static bool patch(int groupingMethod, csr_graph &dest, const csr_graph &before, const ObjectTable &after, const std::vector<std::string> &changedIds)
+    {
+        return withImplicitGraph(groupingMethod, after, [&](const auto &grouped)
+        {
+            dest = patch(before, after, grouped, changedIds);
+        });
+    }
+};
+
+#endif //THEMET_INCREMENTALGROUPER_H
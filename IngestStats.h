@@ -0,0 +1,207 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include "DateCache.h"
+
+#ifndef THEMET_INGESTSTATS_H
+#define THEMET_INGESTSTATS_H
+
+/**
+ * Measurements taken while loading the dataset
+ *
+ * Every thread that takes part in loading fills its own instance, and the instances
+ * are merged once the threads are done. Stage times are therefore summed over all of
+ * the threads that ran the stage, while the wall time is that of the whole load.
+ */
+class IngestStats
+{
+public:
+    enum Stage
+    {
+        Read,
+        Split,
+        Filter,
+        DateParse,
+        Construct,
+        StageCount
+    };
+
+    /**
+     * Adds the time from its construction to its destruction to a stage, if stats are being collected
+     */
+    class Timer
+    {
+    private:
+        IngestStats *_stats;
+        Stage _stage;
+        std::chrono::steady_clock::time_point _start;
+
+    public:
+        Timer(IngestStats *stats, Stage stage) : _stats(stats), _stage(stage), _start()
+        {
+            if (_stats)
+                _start = std::chrono::steady_clock::now();
+        }
+
+        Timer(const Timer &) = delete;
+
+        Timer &operator=(const Timer &) = delete;
+
+        ~Timer()
+        {
+            if (_stats)
+                _stats->stageTime[_stage] += std::chrono::steady_clock::now() - _start;
+        }
+    };
+
+    /**
+     * Rows rejected for one reason, counted by their date
+     */
+    struct Rejections
+    {
+        std::uint64_t count = 0;
+        std::unordered_map<std::string, std::uint64_t> byDate;
+
+        void add(std::string_view date)
+        {
+            ++count;
+            ++byDate[std::string(date)];
+        }
+
+        void merge(const Rejections &other)
+        {
+            count += other.count;
+            for (const auto &pair: other.byDate)
+                byDate[pair.first] += pair.second;
+        }
+    };
+
+    // Where the objects came from ("csv" or "snapshot") and how the CSV was loaded
+    std::string source = "csv";
+    std::string mode = "serial";
+    unsigned threads = 1;
+
+    std::chrono::steady_clock::duration wallTime{};
+    std::chrono::steady_clock::duration stageTime[StageCount]{};
+
+    std::uint64_t rows = 0;
+    std::uint64_t bytes = 0;
+    std::uint64_t objects = 0;
+
+    // Rows dropped because their date is obviously unknown, e.g. "n.d."
+    Rejections filtered;
+
+    // Rows dropped because getYear couldn't make sense of their date
+    Rejections unparseable;
+
+    // How often a date was found in the loader's date cache
+    DateCache::Counts dateCache;
+
+    /**
+     * Add the counts and times of another thread's stats to these
+     * @param other The stats to add
+     */
+    void merge(const IngestStats &other)
+    {
+        for (int i = 0; i < StageCount; ++i)
+            stageTime[i] += other.stageTime[i];
+
+        rows += other.rows;
+        bytes += other.bytes;
+        objects += other.objects;
+        filtered.merge(other.filtered);
+        unparseable.merge(other.unparseable);
+    }
+
+    /**
+     * Write the stats as a JSON object
+     * @param os The output stream
+     * @param maxDates The maximum number of distinct dates to list per rejection reason, most frequent first
+     */
+    void writeJson(std::ostream &os, std::size_t maxDates = 50) const
+    {
+        static const char *stageNames[StageCount] = {"read", "split", "filter", "dateParse", "construct"};
+
+        auto seconds = [](std::chrono::steady_clock::duration d)
+        {
+            return std::chrono::duration<double>(d).count();
+        };
+
+        auto wall = seconds(wallTime);
+
+        os << "{\n";
+        os << "  \"source\": ";
+        writeString(os, source);
+        os << ",\n  \"mode\": ";
+        writeString(os, mode);
+        os << ",\n  \"threads\": " << threads;
+        os << ",\n  \"wallSeconds\": " << wall;
+        os << ",\n  \"rows\": " << rows;
+        os << ",\n  \"bytes\": " << bytes;
+        os << ",\n  \"objects\": " << objects;
+        os << ",\n  \"rowsPerSecond\": " << (wall > 0 ? (double) rows / wall : 0);
+        os << ",\n  \"bytesPerSecond\": " << (wall > 0 ? (double) bytes / wall : 0);
+
+        os << ",\n  \"stageSeconds\": {";
+        for (int i = 0; i < StageCount; ++i)
+            os << (i ? ", " : "") << "\"" << stageNames[i] << "\": " << seconds(stageTime[i]);
+        os << "}";
+
+        auto lookups = dateCache.hits + dateCache.misses;
+        os << ",\n  \"dateCache\": {\"hits\": " << dateCache.hits << ", \"misses\": " << dateCache.misses
+           << ", \"entries\": " << dateCache.entries << ", \"hitRate\": " << (lookups ? (double) dateCache.hits / lookups : 0) << "}";
+
+        os << ",\n  \"rejected\": {\n    \"filter\": ";
+        writeRejections(os, filtered, maxDates);
+        os << ",\n    \"dateParse\": ";
+        writeRejections(os, unparseable, maxDates);
+        os << "\n  }\n}" << std::endl;
+    }
+
+private:
+    static void writeString(std::ostream &os, std::string_view s)
+    {
+        static const char *hex = "0123456789abcdef";
+
+        os << '"';
+        for (unsigned char c: s)
+        {
+            if (c == '"' || c == '\\')
+                os << '\\' << c;
+            else if (c < 0x20)
+                os << "\\u00" << hex[c >> 4] << hex[c & 0xF];
+            else
+                os << c;
+        }
+        os << '"';
+    }
+
+    static void writeRejections(std::ostream &os, const Rejections &rejections, std::size_t maxDates)
+    {
+        std::vector<std::pair<std::string, std::uint64_t>> dates(rejections.byDate.begin(), rejections.byDate.end());
+        std::sort(dates.begin(), dates.end(), [](const auto &a, const auto &b)
+        {
+            return a.second != b.second ? a.second > b.second : a.first < b.first;
+        });
+
+        std::uint64_t listed = 0;
+
+        os << "{\"count\": " << rejections.count << ", \"distinctDates\": " << dates.size() << ", \"byDate\": {";
+        for (std::size_t i = 0; i < dates.size() && i < maxDates; ++i)
+        {
+            os << (i ? ", " : "");
+            writeString(os, dates[i].first);
+            os << ": " << dates[i].second;
+            listed += dates[i].second;
+        }
+        os << "}, \"unlisted\": " << rejections.count - listed << "}";
+    }
+};
+
+#endif //THEMET_INGESTSTATS_H
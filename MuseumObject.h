@@ -1,7 +1,13 @@
+#include <algorithm>
 #include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <stdexcept>
 #include <string>
-#include <regex>
-#include <cmath>
+#include <string_view>
+#include <vector>
+#include "ComparatorKernels.h"
 
 //
 // Created by Admin on 12/9/2021.
@@ -15,15 +21,18 @@ class MuseumObject
 public:
     std::string objectId;
     std::string name;
-    std::string artist;
-    std::string country;
+
+    // IDs of the artist and country in the dictionaries built while loading the dataset
+    std::uint32_t artistId;
+    std::uint32_t countryId;
+
     float date;
 
-    explicit MuseumObject() : objectId(), name(), artist(), country(), date(0)
+    explicit MuseumObject() : objectId(), name(), artistId(0), countryId(0), date(0)
     {}
 
-    MuseumObject(std::string objectId, std::string name, std::string artist, std::string country, float date) : objectId(std::move(objectId)), name(std::move(name)), artist(std::move(artist)),
-                                                                                                                country(std::move(country)), date(date)
+    MuseumObject(std::string objectId, std::string name, std::uint32_t artistId, std::uint32_t countryId, float date) : objectId(std::move(objectId)), name(std::move(name)), artistId(artistId),
+                                                                                                                       countryId(countryId), date(date)
     {}
 
     bool operator<(const MuseumObject &rhs) const
@@ -45,100 +54,404 @@ public:
     {
         return objectId.empty();
     }
+
+    /**
+     * Creates a virtual vertex that stands in for the edges between a group of objects.
+     * Hub IDs start with a NUL, which no object ID read from the dataset can contain
+     * @param name The name of the group, unique among hubs
+     * @return The hub
+     */
+    static MuseumObject hub(const std::string &name)
+    {
+        MuseumObject hub;
+        hub.objectId = std::string(1, '\0') + name;
+        hub.name = name;
+        return hub;
+    }
+
+    [[nodiscard]] bool isHub() const
+    {
+        return !objectId.empty() && objectId[0] == '\0';
+    }
 };
 
+class ObjectTable;
+
+/*
+ * Comparators score a pair of objects either as MuseumObjects, or by the single
+ * attribute they look at (their key), which keys() selects from an ObjectTable column
+ *
+ * A comparator may also test one key against a run of keys at once with
+ * within(key, keys, count, maxCost), which returns a mask of the keys whose pair
+ * costs no more than maxCost. Groupers that find it use it instead of scoring
+ * every pair. The artist and location comparators don't have it: their groupers
+ * only pair objects with equal keys, so there is nothing left to test.
+ */
+
+/**
+ * What the artist and location comparators score a pair of objects with different
+ * keys. It is above every maxCost, so such a pair is never related.
+ *
+ * The original comparators scored a mismatch 0, which is below every maxCost. That
+ * related every pair of objects by different artists (or from different countries)
+ * at no cost. The graph was then complete, and the cheapest path between two works
+ * went through a work by any other artist. Scoring a mismatch as unrelated keeps each
+ * artist's or country's works in their own group. It also lets the groupers skip the
+ * pairs across groups instead of storing a free edge for each of them.
+ */
+constexpr float unrelatedCost = std::numeric_limits<float>::infinity();
+
 struct MuseumObjectArtistComparator
 {
+    typedef std::uint32_t key_type;
+
+    static const std::vector<key_type> &keys(const ObjectTable &objects);
+
+    /**
+     * Objects with different artists are never related, see unrelatedCost
+     */
+    inline float operator()(key_type a, key_type b)
+    {
+        return a == b ? 1 : unrelatedCost;
+    }
+
     inline float operator()(const MuseumObject &a, const MuseumObject &b)
     {
-        return a.artist == b.artist ? 1 : 0;
+        return (*this)(a.artistId, b.artistId);
     }
 };
 
 struct MuseumObjectLocationComparator
 {
+    typedef std::uint32_t key_type;
+
+    static const std::vector<key_type> &keys(const ObjectTable &objects);
+
+    /**
+     * Objects from different countries are never related, see unrelatedCost
+     */
+    inline float operator()(key_type a, key_type b)
+    {
+        return a == b ? 1 : unrelatedCost;
+    }
+
     inline float operator()(const MuseumObject &a, const MuseumObject &b)
     {
-        return a.country == b.country ? 1 : 0;
+        return (*this)(a.countryId, b.countryId);
     }
 };
 
 struct MuseumObjectDateComparator
 {
+    typedef float key_type;
+
+    static const std::vector<key_type> &keys(const ObjectTable &objects);
+
     /**
      * Deserialize a natural-language encoded date
+     *
+     * The date is scanned once, recording the first match of each of the following
+     * forms, and the year is taken from the first form (in this order) that matched:
+     * <ol>
+     *     <li>"15th century", "10th-century" (using dash variants), "early 14th period" and "11th c."</li>
+     *     <li>"3rd millennium"</li>
+     *     <li>"514 B.C."</li>
+     *     <li>"A.D. 25"</li>
+     *     <li>A run of 3 to 4 digits</li>
+     *     <li>Any run of digits</li>
+     * </ol>
+     *
      * @param s The encoded date
      * @return A positive float for A.D. dates, and a negative one for B.C. dates
      */
-    static float getYear(const std::string &s)
+    static float getYear(std::string_view s)
     {
-        std::smatch match;
-
-        auto parsed = false;
-        float year = 0;
+        std::string_view century, millennium, yearEra, eraYear, plainYear, anyNumber;
+        auto bc = false;
 
-        // Test similar to "15th century", "10th-century" (using dash variants), "early 14th period" and "11th c."
-        std::regex regexCentury("(\\d+)..[ –-]+[CcPp]");
-        if (std::regex_search(s, match, regexCentury, std::regex_constants::match_any))
+        for (std::size_t i = 0; i < s.size(); ++i)
         {
-            // Pick the middle date of the century
-            year = ((float) stoi(match[1]) - 1) * 100 + 50;
-            parsed = true;
+            if (isDigit(s[i]))
+            {
+                auto runEnd = i;
+                while (runEnd < s.size() && isDigit(s[runEnd]))
+                    ++runEnd;
+
+                if (century.empty())
+                    century = matchOrdinal(s, i, runEnd, isCenturySeparator, isCenturyUnit);
+
+                if (millennium.empty())
+                    millennium = matchOrdinal(s, i, runEnd, isMillenniumSeparator, isMillenniumUnit);
+
+                // Similar to "514 B.C."
+                if (yearEra.empty() && runEnd < s.size() && s[runEnd] == ' ' && isEra(s, runEnd + 1))
+                    yearEra = s.substr(i, runEnd - i);
+
+                if (plainYear.empty() && runEnd - i >= 3)
+                    plainYear = s.substr(i, std::min<std::size_t>(runEnd - i, 4));
+
+                if (anyNumber.empty())
+                    anyNumber = s.substr(i, runEnd - i);
+
+                i = runEnd - 1;
+                continue;
+            }
+
+            // Similar to "A.D. 25"
+            if (eraYear.empty() && isEra(s, i) && i + 5 < s.size() && s[i + 4] == ' ' && isDigit(s[i + 5]))
+            {
+                auto runEnd = i + 5;
+                while (runEnd < s.size() && isDigit(s[runEnd]))
+                    ++runEnd;
+
+                eraYear = s.substr(i + 5, runEnd - i - 5);
+            }
+
+            if (s.compare(i, 4, "B.C.") == 0)
+                bc = true;
         }
 
-        // Test similar to "3rd millennium"
-        std::regex regexMillennium("(\\d+).. +[Mm]");
-        if (!parsed && std::regex_search(s, match, regexMillennium, std::regex_constants::match_any))
-        {
+        float year;
+
+        if (!century.empty())
+            // Pick the middle date of the century
+            year = (toYear(century) - 1) * 100 + 50;
+        else if (!millennium.empty())
             // Pick the middle date of the millennium
-            year = ((float) stoi(match[1]) - 1) * 1000 + 500;
-            parsed = true;
-        }
+            year = (toYear(millennium) - 1) * 1000 + 500;
+        else if (!yearEra.empty())
+            year = toYear(yearEra);
+        else if (!eraYear.empty())
+            year = toYear(eraYear);
+        else if (!plainYear.empty())
+            year = toYear(plainYear);
+        else if (!anyNumber.empty())
+            year = toYear(anyNumber);
+        else
+            throw std::invalid_argument("Unable to parse date");
 
-        // Test similar to "514 B.C."
-        std::regex regexBC("(\\d+) (B.C.|A.D.)");
-        if (!parsed && std::regex_search(s, match, regexBC, std::regex_constants::match_any))
-        {
-            year = (float) stoi(match[1]);
-            parsed = true;
-        }
+        if (bc)
+            year = -year;
+
+        return year;
+    }
+
+    inline float operator()(key_type a, key_type b)
+    {
+        return std::fabs(a - b);
+    }
+
+    inline float operator()(const MuseumObject &a, const MuseumObject &b)
+    {
+        return (*this)(a.date, b.date);
+    }
+
+    /**
+     * Tests up to comparator_kernels::batchSize keys against a key at once
+     * @return A mask with bit i set if keys[i] is within {maxCost} years of {key}
+     */
+    inline std::uint64_t within(key_type key, const key_type *keys, std::size_t count, float maxCost)
+    {
+        return comparator_kernels::withinDistance(key, keys, count, maxCost);
+    }
+
+private:
+    static bool isDigit(char c)
+    {
+        return c >= '0' && c <= '9';
+    }
+
+    /**
+     * Matches any character but a line break, the way "." does in a regular expression
+     */
+    static bool isAnyCharacter(char c)
+    {
+        return c != '\n' && c != '\r';
+    }
+
+    /**
+     * Matches a space, a hyphen or any byte of a UTF-8 encoded en dash
+     */
+    static bool isCenturySeparator(char c)
+    {
+        return c == ' ' || c == '-' || c == '\xE2' || c == '\x80' || c == '\x93';
+    }
+
+    static bool isCenturyUnit(char c)
+    {
+        return c == 'C' || c == 'c' || c == 'P' || c == 'p';
+    }
 
-        // Test similar to "A.D. 25"
-        std::regex regexAD("(B.C.|A.D.) (\\d+)");
-        if (!parsed && std::regex_search(s, match, regexAD, std::regex_constants::match_any))
+    static bool isMillenniumSeparator(char c)
+    {
+        return c == ' ';
+    }
+
+    static bool isMillenniumUnit(char c)
+    {
+        return c == 'M' || c == 'm';
+    }
+
+    /**
+     * Tests for "B.C." or "A.D.", where the periods may be any character
+     */
+    static bool isEra(std::string_view s, std::size_t i)
+    {
+        if (i + 4 > s.size() || !isAnyCharacter(s[i + 1]) || !isAnyCharacter(s[i + 3]))
+            return false;
+
+        return (s[i] == 'B' && s[i + 2] == 'C') || (s[i] == 'A' && s[i + 2] == 'D');
+    }
+
+    /**
+     * Finds the leftmost ordinal like "15th century" whose digits start in a run of digits,
+     * i.e. digits, a two character suffix, one or more separators and the first letter of the unit.
+     * Earlier starts and then longer digit prefixes are tried first, as a backtracking regex would
+     * @param s The encoded date
+     * @param runBegin The index of the first digit in the run
+     * @param runEnd The index past the last digit in the run
+     * @return The digits of the ordinal, or an empty view if there is none
+     */
+    template<typename IsSeparator, typename IsUnit>
+    static std::string_view matchOrdinal(std::string_view s, std::size_t runBegin, std::size_t runEnd, IsSeparator isSeparator, IsUnit isUnit)
+    {
+        for (auto begin = runBegin; begin < runEnd; ++begin)
+            for (auto end = runEnd; end > begin; --end)
+            {
+                if (end + 2 > s.size() || !isAnyCharacter(s[end]) || !isAnyCharacter(s[end + 1]))
+                    continue;
+
+                auto unit = end + 2;
+                while (unit < s.size() && isSeparator(s[unit]))
+                    ++unit;
+
+                if (unit == end + 2 || unit == s.size() || !isUnit(s[unit]))
+                    continue;
+
+                return s.substr(begin, end - begin);
+            }
+
+        return {};
+    }
+
+    /**
+     * Converts a run of digits into a year, with the same range limits as std::stoi
+     */
+    static float toYear(std::string_view digits)
+    {
+        int value = 0;
+        for (auto c: digits)
         {
-            year = (float) stoi(match[2]);
-            parsed = true;
+            int digit = c - '0';
+            if (value > (std::numeric_limits<int>::max() - digit) / 10)
+                throw std::out_of_range("Year is out of range");
+
+            value = value * 10 + digit;
         }
 
-        // Test for a range of 3 to 4 numbers
-        std::regex regexPlainYear("(\\d{3,4})");
-        if (!parsed && std::regex_search(s, match, regexPlainYear, std::regex_constants::match_any))
+        return (float) value;
+    }
+};
+
+/*
+ * The criteria a MuseumObjectCompositeComparator scores objects by, as flags
+ */
+enum GroupingCriteria : unsigned
+{
+    GroupByDate = 1,
+    GroupByArtist = 2,
+    GroupByLocation = 4
+};
+
+/**
+ * Scores a pair of objects by several of the comparators above at once, as the weighted
+ * sum of their costs. The criteria are chosen at compile time, so the ones that are left
+ * out cost nothing to evaluate
+ *
+ * Objects with different artists or countries are never related when those criteria are
+ * enabled, whatever their weight: the weight scales the cost of a match. Weights must not
+ * be negative, so the cost only grows with the distance between dates.
+ * @tparam Criteria A combination of GroupingCriteria flags
+ */
+template<unsigned Criteria>
+struct MuseumObjectCompositeComparator
+{
+    static_assert(Criteria != 0 && Criteria <= (GroupByDate | GroupByArtist | GroupByLocation), "Unknown grouping criteria");
+
+    static constexpr bool byDate = Criteria & GroupByDate;
+    static constexpr bool byArtist = Criteria & GroupByArtist;
+    static constexpr bool byLocation = Criteria & GroupByLocation;
+
+    /**
+     * The attributes of an object that the criteria look at
+     */
+    struct key_type
+    {
+        float date;
+        std::uint32_t artistId;
+        std::uint32_t countryId;
+    };
+
+    float dateWeight;
+    float artistWeight;
+    float locationWeight;
+
+    explicit MuseumObjectCompositeComparator(float dateWeight = 1, float artistWeight = 1, float locationWeight = 1) : dateWeight(dateWeight), artistWeight(artistWeight),
+                                                                                                                       locationWeight(locationWeight)
+    {}
+
+    static key_type key(const MuseumObject &o)
+    {
+        return {o.date, o.artistId, o.countryId};
+    }
+
+    /**
+     * Orders keys by artist and country, then by date, so that the keys which can be
+     * related are contiguous and sorted by date
+     */
+    static bool isBefore(const key_type &a, const key_type &b)
+    {
+        if constexpr (byArtist)
+            if (a.artistId != b.artistId)
+                return a.artistId < b.artistId;
+
+        if constexpr (byLocation)
+            if (a.countryId != b.countryId)
+                return a.countryId < b.countryId;
+
+        if constexpr (byDate)
+            return a.date < b.date;
+
+        return false;
+    }
+
+    inline float operator()(const key_type &a, const key_type &b) const
+    {
+        float cost = 0;
+
+        if constexpr (byArtist)
         {
-            year = (float) stoi(match[1]);
-            parsed = true;
+            if (a.artistId != b.artistId)
+                return unrelatedCost;
+            cost += artistWeight * MuseumObjectArtistComparator()(a.artistId, b.artistId);
         }
 
-        // Test for any range of numbers
-        std::regex regexHopefullyAYear("(\\d+)");
-        if (!parsed && std::regex_search(s, match, regexHopefullyAYear, std::regex_constants::match_any))
+        if constexpr (byLocation)
         {
-            year = (float) stoi(match[1]);
-            parsed = true;
+            if (a.countryId != b.countryId)
+                return unrelatedCost;
+            cost += locationWeight * MuseumObjectLocationComparator()(a.countryId, b.countryId);
         }
 
-        if (!parsed)
-            throw std::invalid_argument("Unable to parse date");
-
-        if (s.find("B.C.") != std::string::npos)
-            year = -year;
+        if constexpr (byDate)
+            cost += dateWeight * MuseumObjectDateComparator()(a.date, b.date);
 
-        return year;
+        return cost;
     }
 
-    inline float operator()(const MuseumObject &a, const MuseumObject &b)
+    inline float operator()(const MuseumObject &a, const MuseumObject &b) const
     {
-        return std::fabs(a.date - b.date);
+        return (*this)(key(a), key(b));
     }
 };
 
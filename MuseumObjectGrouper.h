@@ -0,0 +1,870 @@
+#include <algorithm>
+#include <cmath>
+#include <concepts>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <type_traits>
+#include <vector>
+#include "csr_graph.h"
+#include "graph.h"
+#include "implicit_graph.h"
+#include "MuseumObject.h"
+#include "ObjectTable.h"
+#include "parallel.h"
+
+#ifndef THEMET_MUSEUMOBJECTGROUPER_H
+#define THEMET_MUSEUMOBJECTGROUPER_H
+
+/**
+ * Inserts the edges between a table's objects into a graph in one bulk build
+ * @param graph The graph to insert into
+ * @param objects The museum objects, which the edges refer to by row
+ * @param edges The edges
+ */
+inline void insertEdges(graph &graph, const ObjectTable &objects, const std::vector<graph::edge> &edges)
+{
+    // Only copy the rows that have edges out of the table
+    std::vector<bool> used(objects.size());
+    for (const auto &e: edges)
+        used[e.from] = used[e.to] = true;
+
+    std::vector<MuseumObject> vertices(objects.size());
+    for (std::uint32_t row = 0; row < objects.size(); ++row)
+        if (used[row])
+            vertices[row] = objects[row].toObject();
+
+    graph.addEdges(vertices, edges);
+}
+
+/**
+ * Builds an immutable CSR graph from the edges between a table's objects
+ * @param graph The graph to replace
+ * @param objects The museum objects, which the edges refer to by row
+ * @param edges The edges
+ */
+inline void insertEdges(csr_graph &graph, const ObjectTable &objects, const std::vector<graph::edge> &edges)
+{
+    graph = csr_graph(objects, edges);
+}
+
+/**
+ * Collects the edges between a table's objects on several threads, then inserts them
+ * into a graph in one bulk build
+ *
+ * The work is split into tasks that each collect their edges into their own buffer, so
+ * the threads share nothing while grouping. The buffers are concatenated in task order,
+ * which makes the graph the same no matter how many threads ran the tasks.
+ * @tparam Graph Either a graph or a csr_graph
+ * @param graph The graph to insert into
+ * @param objects The museum objects, which the edges refer to by row
+ * @param tasks The number of tasks
+ * @param threads The number of threads to run the tasks on
+ * @param task Called as task(index, edges) to collect the edges of a task
+ */
+template<typename Graph, typename F>
+void buildGraph(Graph &graph, const ObjectTable &objects, std::size_t tasks, unsigned threads, F &&task)
+{
+    std::vector<std::vector<graph::edge>> buffers(tasks);
+    parallelFor(tasks, threads, [&](std::size_t i)
+    {
+        task(i, buffers[i]);
+    });
+
+    std::size_t edgeCount = 0;
+    for (const auto &buffer: buffers)
+        edgeCount += buffer.size();
+
+    std::vector<graph::edge> edges;
+    edges.reserve(edgeCount);
+
+    for (auto &buffer: buffers)
+    {
+        edges.insert(edges.end(), buffer.begin(), buffer.end());
+        buffer = {};
+    }
+
+    insertEdges(graph, objects, edges);
+}
+
+// The number of rows each task of the groupers handles
+constexpr std::uint32_t groupingTaskRows = 64;
+
+/**
+ * A comparator that can test one key against a run of keys at once
+ */
+template<typename T>
+concept BatchComparator = requires(T comparator, typename T::key_type key, const typename T::key_type *keys, std::size_t count, float maxCost)
+{
+    { comparator.within(key, keys, count, maxCost) } -> std::same_as<std::uint64_t>;
+};
+
+/**
+ * Provides a standardized way to insert pairs of MuseumObjects
+ * into the graph using the scoring function provided by T
+ * @tparam T The scoring function
+ */
+template<typename T>
+class MuseumObjectGrouper
+{
+public:
+    /**
+     * Group pairs of objects using the scoring function
+     * @param maxCost The maximum cost allowed between vertices to still generate a connection
+     * @param graph The graph to insert into
+     * @param objects The museum objects to source from
+     */
+    static void groupObjects(float maxCost, graph &graph, const std::vector<MuseumObject> &objects)
+    {
+        auto comparator = T();
+
+        for (const auto &oLeft: objects)
+            for (const auto &oRight: objects)
+            {
+                // Don't compare objects to themselves
+                if (&oLeft == &oRight)
+                    continue;
+
+                auto similarityCost = comparator(oLeft, oRight);
+                if (similarityCost > maxCost)
+                    continue;
+
+                graph.addEdge(oLeft, oRight, similarityCost);
+            }
+    }
+
+    /**
+     * Group pairs of objects using the scoring function, reading only the
+     * column of the table that the scoring function looks at. If the scoring
+     * function is a BatchComparator, each object is tested against a batch
+     * of others at once
+     * @param maxCost The maximum cost allowed between vertices to still generate a connection
+     * @param graph The graph to insert into
+     * @param objects The museum objects to source from
+     * @param threads The number of threads to score pairs on
+     */
+    template<typename Graph>
+    static void groupObjects(float maxCost, Graph &graph, const ObjectTable &objects, unsigned threads = 1)
+    {
+        const auto &keys = T::keys(objects);
+        auto tasks = (keys.size() + groupingTaskRows - 1) / groupingTaskRows;
+
+        buildGraph(graph, objects, tasks, threads, [&](std::size_t task, std::vector<graph::edge> &edges)
+        {
+            auto comparator = T();
+            auto begin = (std::uint32_t) task * groupingTaskRows;
+            auto end = std::min(begin + groupingTaskRows, (std::uint32_t) keys.size());
+
+            for (auto left = begin; left < end; ++left)
+            {
+                if constexpr (BatchComparator<T>)
+                {
+                    // Test a batch of keys at once, and only score the pairs that pass
+                    for (std::uint32_t batch = 0; batch < keys.size(); batch += comparator_kernels::batchSize)
+                    {
+                        auto count = std::min<std::size_t>(comparator_kernels::batchSize, keys.size() - batch);
+                        auto mask = comparator.within(keys[left], keys.data() + batch, count, maxCost);
+
+                        // Don't compare objects to themselves
+                        if (left >= batch && left - batch < count)
+                            mask &= ~((std::uint64_t) 1 << (left - batch));
+
+                        for (; mask != 0; mask &= mask - 1)
+                        {
+                            auto right = batch + (std::uint32_t) __builtin_ctzll(mask);
+                            edges.push_back({left, right, comparator(keys[left], keys[right])});
+                        }
+                    }
+                }
+                else
+                {
+                    for (std::uint32_t right = 0; right < keys.size(); ++right)
+                    {
+                        // Don't compare objects to themselves
+                        if (left == right)
+                            continue;
+
+                        auto similarityCost = comparator(keys[left], keys[right]);
+                        if (similarityCost > maxCost)
+                            continue;
+
+                        edges.push_back({left, right, similarityCost});
+                    }
+                }
+            }
+        });
+    }
+};
+
+/**
+ * Groups objects using a scoring function that only relates objects with equal keys,
+ * such as the artist and location comparators
+ *
+ * The objects are partitioned into one bucket per key, and only pairs within a bucket
+ * are scored, which takes the sum of the squared bucket sizes rather than the square
+ * of the number of objects.
+ * @tparam T The scoring function, whose keys must be dense IDs (e.g. dictionary IDs)
+ */
+template<typename T>
+class MuseumObjectBucketGrouper
+{
+public:
+    /**
+     * Group pairs of objects with equal keys using the scoring function
+     * @param maxCost The maximum cost allowed between vertices to still generate a connection
+     * @param graph The graph to insert into
+     * @param objects The museum objects to source from
+     */
+    template<typename Graph>
+    static void groupObjects(float maxCost, Graph &graph, const ObjectTable &objects, unsigned threads = 1)
+    {
+        const auto &keys = T::keys(objects);
+
+        if (keys.empty())
+            return;
+
+        /*
+         * Counting sort the row indices by key, so each bucket is a contiguous
+         * run of {rows} from bucketStart[key] to bucketStart[key + 1]
+         */
+
+        auto keyCount = (std::size_t) *std::max_element(keys.begin(), keys.end()) + 1;
+
+        std::vector<std::uint32_t> bucketStart(keyCount + 1, 0);
+        for (auto key: keys)
+            ++bucketStart[key + 1];
+        for (std::size_t key = 0; key < keyCount; ++key)
+            bucketStart[key + 1] += bucketStart[key];
+
+        std::vector<std::uint32_t> rows(keys.size());
+        auto next = bucketStart;
+        for (std::uint32_t row = 0; row < keys.size(); ++row)
+            rows[next[keys[row]]++] = row;
+
+        // One task per bucket
+        buildGraph(graph, objects, keyCount, threads, [&](std::size_t key, std::vector<graph::edge> &edges)
+        {
+            auto comparator = T();
+            auto begin = bucketStart[key], end = bucketStart[key + 1];
+            if (end - begin < 2)
+                return;
+
+            // Every pair in a bucket has the same key, so they all score the same
+            auto similarityCost = comparator((typename T::key_type) key, (typename T::key_type) key);
+            if (similarityCost > maxCost)
+                return;
+
+            // Edges are undirected, so each pair is only added once
+            for (auto left = begin; left < end; ++left)
+                for (auto right = left + 1; right < end; ++right)
+                    edges.push_back({rows[left], rows[right], similarityCost});
+        });
+    }
+
+    /**
+     * Group pairs of objects with equal keys using the scoring function. There are only
+     * a few of these objects (e.g. the exhibit items), so every pair is scored on the
+     * calling thread
+     */
+    static void groupObjects(float maxCost, graph &graph, const std::vector<MuseumObject> &objects, unsigned = 1)
+    {
+        MuseumObjectGrouper<T>::groupObjects(maxCost, graph, objects);
+    }
+};
+
+/**
+ * Groups objects like MuseumObjectBucketGrouper, but links the objects of each bucket
+ * through a virtual hub vertex instead of to each other
+ *
+ * A bucket of k objects becomes a star of k spokes, each half the cost of a pair, rather
+ * than a clique of k^2 edges. Paths between objects cost the same as in the clique, and
+ * graph's dijkstra and mst leave the hubs out of what they return.
+ * @tparam T The scoring function, whose keys must be dense IDs (e.g. dictionary IDs)
+ */
+template<typename T>
+class MuseumObjectHubGrouper
+{
+public:
+    /**
+     * Link the objects with equal keys through a hub per key
+     * @param maxCost The maximum cost allowed between vertices to still generate a connection
+     * @param graph The graph to insert into
+     * @param objects The museum objects to source from
+     * @param hubPrefix Prepended to the key to name each hub, e.g. "artist "
+     */
+    static void groupObjects(float maxCost, graph &graph, const ObjectTable &objects, const std::string &hubPrefix)
+    {
+        const auto &keys = T::keys(objects);
+
+        if (keys.empty())
+            return;
+
+        auto comparator = T();
+        auto keyCount = (std::size_t) *std::max_element(keys.begin(), keys.end()) + 1;
+
+        std::vector<std::uint32_t> bucketSize(keyCount, 0);
+        for (auto key: keys)
+            ++bucketSize[key];
+
+        // The objects are followed by the hubs, which the spokes refer to by index
+        std::vector<MuseumObject> vertices(objects.size());
+        std::vector<std::uint32_t> hubs(keyCount, 0);
+
+        for (std::size_t key = 0; key < keyCount; ++key)
+        {
+            if (bucketSize[key] < 2 || comparator((typename T::key_type) key, (typename T::key_type) key) > maxCost)
+                continue;
+
+            hubs[key] = (std::uint32_t) vertices.size();
+            vertices.push_back(MuseumObject::hub(hubPrefix + std::to_string(key)));
+        }
+
+        std::vector<graph::edge> spokes;
+        for (std::uint32_t row = 0; row < keys.size(); ++row)
+        {
+            if (!hubs[keys[row]])
+                continue;
+
+            // Every pair in a bucket has the same key, so they all score the same
+            auto similarityCost = comparator(keys[row], keys[row]);
+
+            vertices[row] = objects[row].toObject();
+            spokes.push_back({hubs[keys[row]], row, similarityCost / 2});
+        }
+
+        graph.addEdges(vertices, spokes);
+    }
+};
+
+/**
+ * Groups objects using a scoring function that is the distance between their keys,
+ * such as the date comparator
+ *
+ * The objects are sorted by key and a window is swept over them, so only the pairs
+ * within {maxCost} of each other are scored. This takes O(n log n + E) rather than
+ * O(n^2) for E edges. If the scoring function is a BatchComparator, the window is
+ * tested a batch of keys at a time.
+ * @tparam T The scoring function, whose keys must be floats
+ */
+template<typename T>
+class MuseumObjectSweepGrouper
+{
+public:
+    /**
+     * Group pairs of objects whose keys are within {maxCost} of each other
+     * @param maxCost The maximum cost allowed between vertices to still generate a connection
+     * @param graph The graph to insert into
+     * @param objects The museum objects to source from
+     */
+    template<typename Graph>
+    static void groupObjects(float maxCost, Graph &graph, const ObjectTable &objects, unsigned threads = 1)
+    {
+        const auto &keys = T::keys(objects);
+        auto rows = sortByKey(keys);
+        auto tasks = (rows.size() + groupingTaskRows - 1) / groupingTaskRows;
+
+        // The keys in sorted order, so that a batch of the ones past an object can be tested at once
+        std::vector<float> sortedKeys;
+        if constexpr (BatchComparator<T>)
+        {
+            sortedKeys.resize(rows.size());
+            for (std::size_t i = 0; i < rows.size(); ++i)
+                sortedKeys[i] = keys[rows[i]];
+        }
+
+        buildGraph(graph, objects, tasks, threads, [&](std::size_t task, std::vector<graph::edge> &edges)
+        {
+            auto comparator = T();
+            auto begin = task * groupingTaskRows;
+            auto end = std::min<std::size_t>(begin + groupingTaskRows, rows.size());
+
+            for (auto left = begin; left < end; ++left)
+            {
+                if constexpr (BatchComparator<T>)
+                {
+                    for (auto batch = left + 1; batch < rows.size(); batch += comparator_kernels::batchSize)
+                    {
+                        auto count = std::min<std::size_t>(comparator_kernels::batchSize, rows.size() - batch);
+                        auto mask = comparator.within(sortedKeys[left], sortedKeys.data() + batch, count, maxCost);
+
+                        // The keys are sorted, so the ones that pass are a run at the start of the batch
+                        auto passed = ~mask == 0 ? count : (std::size_t) __builtin_ctzll(~mask);
+
+                        // Edges are undirected, so this also adds the edges from right to left
+                        for (auto right = batch; right < batch + passed; ++right)
+                            edges.push_back({rows[left], rows[right], comparator(sortedKeys[left], sortedKeys[right])});
+
+                        if (passed < count)
+                            break;
+                    }
+                }
+                else
+                {
+                    for (auto right = left + 1; right < rows.size(); ++right)
+                    {
+                        // The keys are sorted, so every object past this one is even further away
+                        auto similarityCost = comparator(keys[rows[left]], keys[rows[right]]);
+                        if (similarityCost > maxCost)
+                            break;
+
+                        // Edges are undirected, so this also adds the edge from right to left
+                        edges.push_back({rows[left], rows[right], similarityCost});
+                    }
+                }
+            }
+        });
+    }
+
+    /**
+     * Group pairs of objects whose keys are within {maxCost} of each other. There are
+     * only a few of these objects (e.g. the exhibit items), so every pair is scored on
+     * the calling thread
+     */
+    static void groupObjects(float maxCost, graph &graph, const std::vector<MuseumObject> &objects, unsigned = 1)
+    {
+        MuseumObjectGrouper<T>::groupObjects(maxCost, graph, objects);
+    }
+
+private:
+    /**
+     * Radix sorts row indices by their float keys, 8 bits at a time
+     * @param keys The key of each row
+     * @return The row indices, in ascending order of their keys
+     */
+    static std::vector<std::uint32_t> sortByKey(const std::vector<float> &keys)
+    {
+        // Flip the bits of floats so that they sort as unsigned integers: negative
+        // numbers sort in reverse, and below all positive numbers
+        std::vector<std::uint32_t> bits(keys.size());
+        for (std::size_t i = 0; i < keys.size(); ++i)
+        {
+            std::uint32_t b;
+            std::memcpy(&b, &keys[i], sizeof(b));
+            bits[i] = (b & 0x80000000u) ? ~b : b | 0x80000000u;
+        }
+
+        std::vector<std::uint32_t> rows(keys.size()), scratch(keys.size());
+        for (std::uint32_t i = 0; i < rows.size(); ++i)
+            rows[i] = i;
+
+        for (int shift = 0; shift < 32; shift += 8)
+        {
+            std::size_t start[257] = {};
+            for (auto row: rows)
+                ++start[((bits[row] >> shift) & 0xFF) + 1];
+            for (int digit = 0; digit < 256; ++digit)
+                start[digit + 1] += start[digit];
+
+            for (auto row: rows)
+                scratch[start[(bits[row] >> shift) & 0xFF]++] = row;
+
+            rows.swap(scratch);
+        }
+
+        return rows;
+    }
+};
+
+/**
+ * Groups objects by several criteria at once with a MuseumObjectCompositeComparator,
+ * in one pass and into one graph
+ *
+ * The rows are sorted by their artist and country (for the criteria that are enabled)
+ * and then by date, and a window is swept over them like in MuseumObjectSweepGrouper:
+ * the cost of a pair only grows along the sorted rows until the next artist or country,
+ * where it becomes infinite.
+ * @tparam Criteria A combination of GroupingCriteria flags
+ */
+template<unsigned Criteria>
+class MuseumObjectCompositeGrouper
+{
+public:
+    typedef MuseumObjectCompositeComparator<Criteria> comparator_type;
+
+    /**
+     * Group pairs of objects using the weighted criteria
+     * @param comparator The comparator, with the weight of each criterion
+     * @param maxCost The maximum cost allowed between vertices to still generate a connection
+     * @param graph The graph to insert into
+     * @param objects The museum objects to source from
+     * @param threads The number of threads to score pairs on
+     */
+    template<typename Graph>
+    static void groupObjects(const comparator_type &comparator, float maxCost, Graph &graph, const ObjectTable &objects, unsigned threads = 1)
+    {
+        typedef typename comparator_type::key_type key_type;
+
+        // Gather the columns of the enabled criteria
+        std::vector<key_type> keys(objects.size());
+        for (std::uint32_t row = 0; row < keys.size(); ++row)
+        {
+            if constexpr (comparator_type::byDate)
+                keys[row].date = objects.dates()[row];
+            if constexpr (comparator_type::byArtist)
+                keys[row].artistId = objects.artistIds()[row];
+            if constexpr (comparator_type::byLocation)
+                keys[row].countryId = objects.countryIds()[row];
+        }
+
+        std::vector<std::uint32_t> rows(keys.size());
+        for (std::uint32_t row = 0; row < rows.size(); ++row)
+            rows[row] = row;
+
+        std::sort(rows.begin(), rows.end(), [&](std::uint32_t a, std::uint32_t b)
+        {
+            if (comparator_type::isBefore(keys[a], keys[b]))
+                return true;
+            if (comparator_type::isBefore(keys[b], keys[a]))
+                return false;
+            return a < b;
+        });
+
+        auto tasks = (rows.size() + groupingTaskRows - 1) / groupingTaskRows;
+
+        buildGraph(graph, objects, tasks, threads, [&](std::size_t task, std::vector<graph::edge> &edges)
+        {
+            auto begin = task * groupingTaskRows;
+            auto end = std::min<std::size_t>(begin + groupingTaskRows, rows.size());
+
+            for (auto left = begin; left < end; ++left)
+                for (auto right = left + 1; right < rows.size(); ++right)
+                {
+                    // Every object past this one is either further away in time, or by another artist or from another country
+                    auto similarityCost = comparator(keys[rows[left]], keys[rows[right]]);
+                    if (similarityCost > maxCost)
+                        break;
+
+                    // Edges are undirected, so this also adds the edge from right to left
+                    edges.push_back({rows[left], rows[right], similarityCost});
+                }
+        });
+    }
+
+    /**
+     * Group pairs of objects using the weighted criteria. There are only a few of these
+     * objects (e.g. the exhibit items), so every pair is scored on the calling thread
+     */
+    static void groupObjects(const comparator_type &comparator, float maxCost, graph &graph, const std::vector<MuseumObject> &objects, unsigned = 1)
+    {
+        for (const auto &oLeft: objects)
+            for (const auto &oRight: objects)
+            {
+                // Don't compare objects to themselves
+                if (&oLeft == &oRight)
+                    continue;
+
+                auto similarityCost = comparator(oLeft, oRight);
+                if (similarityCost > maxCost)
+                    continue;
+
+                graph.addEdge(oLeft, oRight, similarityCost);
+            }
+    }
+};
+
+/**
+ * Groups objects into a sparse graph that links each object to at most its k nearest
+ * neighbors, rather than to every object within {maxCost}
+ *
+ * Comparators with integer keys (artist, location) score every pair with equal keys the
+ * same, which makes each key's bucket a clique. Here an object only links to the k
+ * objects in its bucket with the closest dates. With float keys (date), an object links
+ * to the k objects with the closest keys. Edges are undirected, so an object can end up
+ * with more than k edges, but the graph never has more than k * n.
+ *
+ * One of the k neighbors is always the next object in sorted order. Many objects share a
+ * date, and without it those would only link among themselves; with it, the graph
+ * connects the same objects as the complete graph does, so a path exists in one exactly
+ * when it exists in the other.
+ *
+ * Equally close objects are taken in a fixed order, so the graph doesn't depend on the
+ * number of threads.
+ * @tparam T The scoring function
+ */
+template<typename T>
+class MuseumObjectKnnGrouper
+{
+private:
+    static constexpr bool isDistance = std::is_floating_point_v<typename T::key_type>;
+
+public:
+    /**
+     * Link each object to its k nearest neighbors using the scoring function
+     * @param k The number of neighbors to keep per object
+     * @param maxCost The maximum cost allowed between vertices to still generate a connection
+     * @param graph The graph to insert into
+     * @param objects The museum objects to source from
+     * @param threads The number of threads to score pairs on
+     */
+    template<typename Graph>
+    static void groupObjects(unsigned k, float maxCost, Graph &graph, const ObjectTable &objects, unsigned threads = 1)
+    {
+        const auto &keys = T::keys(objects);
+        const auto &dates = objects.dates();
+
+        if (keys.empty() || k == 0)
+            return;
+
+        /*
+         * Sort the rows into runs that can be related, each sorted by how close its
+         * objects are: one run sorted by key for float keys, or one run per key sorted
+         * by date for integer keys
+         */
+
+        std::vector<std::uint32_t> rows(keys.size());
+        std::vector<std::uint32_t> runStart;
+
+        // What the closeness of objects is measured by
+        auto position = [&](std::uint32_t row) -> float
+        {
+            if constexpr (isDistance)
+                return keys[row];
+            else
+                return dates[row];
+        };
+
+        auto byDistance = [&](std::uint32_t a, std::uint32_t b)
+        {
+            return position(a) != position(b) ? position(a) < position(b) : a < b;
+        };
+
+        if constexpr (isDistance)
+        {
+            for (std::uint32_t row = 0; row < rows.size(); ++row)
+                rows[row] = row;
+
+            std::sort(rows.begin(), rows.end(), byDistance);
+            runStart = {0, (std::uint32_t) rows.size()};
+        }
+        else
+        {
+            auto keyCount = (std::size_t) *std::max_element(keys.begin(), keys.end()) + 1;
+
+            runStart.assign(keyCount + 1, 0);
+            for (auto key: keys)
+                ++runStart[key + 1];
+            for (std::size_t key = 0; key < keyCount; ++key)
+                runStart[key + 1] += runStart[key];
+
+            auto next = runStart;
+            for (std::uint32_t row = 0; row < keys.size(); ++row)
+                rows[next[keys[row]]++] = row;
+
+            for (std::size_t key = 0; key < keyCount; ++key)
+                std::sort(rows.begin() + runStart[key], rows.begin() + runStart[key + 1], byDistance);
+        }
+
+        auto distance = [&](std::uint32_t a, std::uint32_t b)
+        {
+            return std::fabs(position(a) - position(b));
+        };
+
+        auto tasks = (rows.size() + groupingTaskRows - 1) / groupingTaskRows;
+
+        buildGraph(graph, objects, tasks, threads, [&](std::size_t task, std::vector<graph::edge> &edges)
+        {
+            auto comparator = T();
+            auto begin = (std::uint32_t) task * groupingTaskRows;
+            auto end = std::min(begin + groupingTaskRows, (std::uint32_t) rows.size());
+
+            auto run = std::upper_bound(runStart.begin(), runStart.end(), begin) - runStart.begin() - 1;
+
+            for (auto i = begin; i < end; ++i)
+            {
+                while (runStart[run + 1] <= i)
+                    ++run;
+
+                auto row = rows[i];
+                auto left = i, right = i + 1, runEnd = runStart[run + 1];
+                unsigned found = 0;
+
+                // The next object in the run always comes first, which chains the run together
+                if (right < runEnd)
+                {
+                    auto similarityCost = comparator(keys[row], keys[rows[right]]);
+                    if (similarityCost <= maxCost)
+                    {
+                        edges.push_back({row, rows[right++], similarityCost});
+                        ++found;
+                    }
+                    else
+                        right = runEnd;
+                }
+
+                // Then walk out from the object in both directions, taking the closer side each time
+                for (; found < k; ++found)
+                {
+                    bool hasLeft = left > runStart[run], hasRight = right < runEnd;
+                    if (!hasLeft && !hasRight)
+                        break;
+
+                    std::uint32_t neighbor;
+                    if (hasLeft && (!hasRight || distance(row, rows[left - 1]) <= distance(row, rows[right])))
+                        neighbor = rows[--left];
+                    else
+                        neighbor = rows[right++];
+
+                    // Every object further out is at least as far away
+                    auto similarityCost = comparator(keys[row], keys[neighbor]);
+                    if (similarityCost > maxCost)
+                        break;
+
+                    edges.push_back({row, neighbor, similarityCost});
+                }
+            }
+        });
+    }
+};
+
+/*
+ * The maximum cost between two objects that are still related, per grouping method
+ */
+
+constexpr float dateMaxCost = 100;
+constexpr float artistMaxCost = 2;
+constexpr float locationMaxCost = 2;
+
+// Objects by the same artist from the same country, made within dateMaxCost years of each other
+constexpr float compositeMaxCost = dateMaxCost + artistMaxCost / 2 + locationMaxCost / 2;
+
+/**
+ * Gets the maximum cost that fillGraph and fillKnnGraph relate objects within
+ * @param groupingMethod The method by which to score pairs
+ * @return The maximum cost, or 0 for unknown methods
+ */
+constexpr float groupingMaxCost(int groupingMethod)
+{
+    switch (groupingMethod)
+    {
+        case 1:
+            return dateMaxCost;
+        case 2:
+            return artistMaxCost;
+        case 3:
+            return locationMaxCost;
+        case 4:
+            return compositeMaxCost;
+        default:
+            return 0;
+    }
+}
+
+// The most neighbors per object to keep when the complete graph doesn't fit in memory
+constexpr unsigned defaultNearestNeighbors = 10;
+
+/**
+ * Use the specified comparison method to insert all pairs in {src} into {dest}
+ * @tparam Graph Either a graph or, for an ObjectTable, a csr_graph
+ * @tparam Objects Either a vector of MuseumObjects or an ObjectTable
+ * @param groupingMethod The method by which to score pairs
+ * @param dest The destination graph
+ * @param src The source data
+ * @param threads The number of threads to group a table's objects on
+ */
+template<typename Graph, typename Objects>
+void fillGraph(int groupingMethod, Graph &dest, const Objects &src, unsigned threads = 1)
+{
+    switch (groupingMethod)
+    {
+        case 1:
+            MuseumObjectSweepGrouper<MuseumObjectDateComparator>::groupObjects(dateMaxCost, dest, src, threads);
+            break;
+        case 2:
+            MuseumObjectBucketGrouper<MuseumObjectArtistComparator>::groupObjects(artistMaxCost, dest, src, threads);
+            break;
+        case 3:
+            MuseumObjectBucketGrouper<MuseumObjectLocationComparator>::groupObjects(locationMaxCost, dest, src, threads);
+            break;
+        case 4:
+        {
+            typedef MuseumObjectCompositeGrouper<GroupByDate | GroupByArtist | GroupByLocation> grouper;
+            grouper::groupObjects(grouper::comparator_type(), compositeMaxCost, dest, src, threads);
+            break;
+        }
+        default:
+            return;
+    }
+}
+
+/**
+ * Use the specified comparison method to link every object in {src} to its k nearest
+ * neighbors in {dest}
+ * @tparam Graph Either a graph or a csr_graph
+ * @param groupingMethod The method by which to score pairs
+ * @param dest The destination graph
+ * @param src The source data
+ * @param k The number of neighbors to keep per object
+ * @param threads The number of threads to group the objects on
+ * @return Whether the method can be sparsified. Composite methods can only fill a complete graph
+ */
+template<typename Graph>
+bool fillKnnGraph(int groupingMethod, Graph &dest, const ObjectTable &src, unsigned k, unsigned threads = 1)
+{
+    switch (groupingMethod)
+    {
+        case 1:
+            MuseumObjectKnnGrouper<MuseumObjectDateComparator>::groupObjects(k, dateMaxCost, dest, src, threads);
+            return true;
+        case 2:
+            MuseumObjectKnnGrouper<MuseumObjectArtistComparator>::groupObjects(k, artistMaxCost, dest, src, threads);
+            return true;
+        case 3:
+            MuseumObjectKnnGrouper<MuseumObjectLocationComparator>::groupObjects(k, locationMaxCost, dest, src, threads);
+            return true;
+        default:
+            return false;
+    }
+}
+
+/**
+ * Use the specified comparison method to link the objects in {src} that it relates
+ * through a hub vertex per group in {dest}, rather than to each other
+ * @param groupingMethod The method by which to score pairs
+ * @param dest The destination graph
+ * @param src The source data
+ * @return Whether the method groups objects into cliques that can be compressed. Only artist and location grouping do
+ */
+inline bool fillHubGraph(int groupingMethod, graph &dest, const ObjectTable &src)
+{
+    switch (groupingMethod)
+    {
+        case 2:
+            MuseumObjectHubGrouper<MuseumObjectArtistComparator>::groupObjects(artistMaxCost, dest, src, "artist ");
+            return true;
+        case 3:
+            MuseumObjectHubGrouper<MuseumObjectLocationComparator>::groupObjects(locationMaxCost, dest, src, "country ");
+            return true;
+        default:
+            return false;
+    }
+}
+
+/**
+ * Use the specified comparison method to relate all pairs in {src} without storing the
+ * edges, and pass the resulting implicit_graph to {fn}
+ * @param groupingMethod The method by which to score pairs
+ * @param src The source data
+ * @param fn Called with the graph, if the method has one
+ * @return Whether the method can be grouped implicitly. Composite methods can only fill a graph
+ */
+template<typename F>
+bool withImplicitGraph(int groupingMethod, const ObjectTable &src, F &&fn)
+{
+    switch (groupingMethod)
+    {
+        case 1:
+            fn(implicit_graph<MuseumObjectDateComparator>(src, dateMaxCost));
+            return true;
+        case 2:
+            fn(implicit_graph<MuseumObjectArtistComparator>(src, artistMaxCost));
+            return true;
+        case 3:
+            fn(implicit_graph<MuseumObjectLocationComparator>(src, locationMaxCost));
+            return true;
+        default:
+            return false;
+    }
+}
+
+#endif //THEMET_MUSEUMOBJECTGROUPER_H
@@ -0,0 +1,643 @@
+#include <algorithm>
+#include <chrono>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+#include "csv.h"
+#include "BoundedQueue.h"
+#include "DateCache.h"
+#include "IngestStats.h"
+#include "parallel.h"
+#include "MuseumObject.h"
+#include "ObjectDelta.h"
+#include "ObjectTable.h"
+
+#ifndef THEMET_MUSEUMOBJECTLOADER_H
+#define THEMET_MUSEUMOBJECTLOADER_H
+
+/**
+ * Loads the MuseumObjects from the MET's open access CSV dataset
+ *
+ * The columns in the CSV dataset are, in order:
+ *
+ * Object Number, Is Highlight, Is Timeline Work, Is Public Domain, Object ID,
+ * Gallery Number, Department, AccessionYear, Object Name, Title, Culture, Period,
+ * Dynasty, Reign, Portfolio, Constituent ID, Artist Role, Artist Prefix, Artist Display Name,
+ * Artist Display Bio, Artist Suffix, Artist Alpha Sort, Artist Nationality, Artist Begin Date,
+ * Artist End Date, Artist Gender, Artist ULAN URL, Artist Wikidata URL, Object Date, Object Begin Date,
+ * Object End Date, Medium, Dimensions, Credit Line, Geography Type, City, State, County,
+ * Country, Region, Subregion, Locale, Locus, Excavation, River, Classification,
+ * Rights and Reproduction, Link Resource, Object Wikidata URL, Metadata Date, Repository,
+ * Tags, Tags AAT URL, Tags Wikidata URL
+ */
+class MuseumObjectLoader
+{
+public:
+    typedef io::CSVReader<6, io::trim_chars<' '>, io::double_quote_escape<',', '\"'>> reader;
+    typedef io::CSVReader<7, io::trim_chars<' '>, io::double_quote_escape<',', '\"'>> delta_reader;
+
+    /**
+     * How to load the dataset
+     */
+    struct Options
+    {
+        // The number of threads to parse with. Files that can't be memory-mapped
+        // (pipes, stdin, ...) are parsed on the calling thread unless pipelined
+        unsigned threads = 1;
+
+        // Read, split, filter, convert dates and append as concurrent pipeline
+        // stages, instead of parsing chunks of the file side by side
+        bool pipeline = false;
+
+        // The number of pipeline threads converting dates
+        unsigned dateWorkers = 2;
+
+        // If set, filled with timings and counts of the load
+        IngestStats *stats = nullptr;
+    };
+
+    /**
+     * Load all of the usable objects from the dataset
+     * @param path The path to the CSV dataset
+     * @param options How to load the dataset
+     * @return The objects, in the order they appear in the file
+     */
+    static ObjectTable load(const std::string &path, const Options &options)
+    {
+        auto start = std::chrono::steady_clock::now();
+
+        DateCache dates;
+        auto objects = loadCsv(path, options, dates);
+
+        if (options.stats)
+        {
+            options.stats->wallTime = std::chrono::steady_clock::now() - start;
+            options.stats->dateCache = dates.counts();
+        }
+
+        return objects;
+    }
+
+    /**
+     * Load the changes from a delta file, which has the columns of the dataset and a "Change" column
+     * @param path The path to the delta file
+     * @return The changes, in the order they appear in the file
+     */
+    static ObjectDelta loadDelta(const std::string &path)
+    {
+        DateCache dates;
+        ObjectDelta delta;
+
+        delta_reader in(path);
+        in.read_header(io::ignore_extra_column, "Object Number", "Is Highlight", "Title", "Artist Display Name", "Country", "Object Date", "Change");
+
+        std::string objectId, isHighlight, name, artist, country, date, change;
+        while (in.read_row(objectId, isHighlight, name, artist, country, date, change))
+        {
+            if (change == "removed")
+            {
+                delta.changes.push_back({objectId, {}});
+                continue;
+            }
+
+            if (change != "added" && change != "changed")
+                throw std::invalid_argument("Unknown change \"" + change + "\" to object " + objectId + " in " + path);
+
+            auto dateNumeric = isUnknownDate(date) ? std::nullopt : dates.getYear(date);
+            if (!dateNumeric)
+            {
+                delta.changes.push_back({objectId, {}});
+                continue;
+            }
+
+            delta.objects.add(objectId, name, artist, country, *dateNumeric);
+            delta.changes.push_back({objectId, delta.objects.size() - 1});
+        }
+
+        return delta;
+    }
+
+private:
+    static ObjectTable loadCsv(const std::string &path, const Options &options, DateCache &dates)
+    {
+        auto stats = options.stats;
+
+        if (options.pipeline)
+        {
+            auto dateWorkers = std::max(1u, options.dateWorkers);
+            if (stats)
+            {
+                stats->mode = "pipeline";
+                stats->threads = dateWorkers;
+            }
+
+            return loadPipelined(path, dateWorkers, dates, stats);
+        }
+
+#ifdef CSV_IO_MMAP
+        if (options.threads > 1)
+        {
+            auto mapping = io::detail::MappedFile::open(path.c_str());
+            if (mapping)
+            {
+                if (stats)
+                {
+                    stats->mode = "parallel";
+                    stats->threads = options.threads;
+                }
+
+                return loadParallel(path, mapping->data(), mapping->data() + mapping->size(), options.threads, dates, stats);
+            }
+        }
+#endif
+
+        if (stats)
+        {
+            stats->mode = "serial";
+            stats->threads = 1;
+        }
+
+        reader in(path);
+        readHeader(in);
+
+        ObjectTable objects;
+        readObjects(in, objects, dates, stats);
+        return objects;
+    }
+
+    static void readHeader(reader &in)
+    {
+        in.read_header(io::ignore_extra_column, "Object Number", "Is Highlight", "Title", "Artist Display Name", "Country", "Object Date");
+    }
+
+    static bool isUnknownDate(const std::string &date)
+    {
+        // I'm going to strangle the data entry team at the MET
+        return date.empty() || date == "Date unknown" || date == "date unknown" || date == "date uncertain" || date == "n.d." || date == "unknown";
+    }
+
+    /**
+     * Read the remaining rows of a reader, keeping the ones with a usable date
+     * @param in The reader, positioned after the header
+     * @param objects The table to append the objects to
+     * @param dates The cache to convert the dates with
+     * @param stats The stats to fill, or nullptr
+     */
+    static void readObjects(reader &in, ObjectTable &objects, DateCache &dates, IngestStats *stats)
+    {
+        std::string record, objectId, isHighlight, name, artist, country, date;
+
+        while (true)
+        {
+            {
+                IngestStats::Timer timer(stats, IngestStats::Read);
+                if (!in.read_record(record))
+                    break;
+            }
+
+            if (stats)
+            {
+                ++stats->rows;
+                stats->bytes += record.size() + 1;
+            }
+
+            {
+                IngestStats::Timer timer(stats, IngestStats::Split);
+                try
+                {
+                    in.parse_record(record.data(), objectId, isHighlight, name, artist, country, date);
+                }
+                catch (io::error::with_file_line &err)
+                {
+                    err.set_file_line(in.get_file_line());
+                    throw;
+                }
+            }
+
+            bool unknown;
+            {
+                IngestStats::Timer timer(stats, IngestStats::Filter);
+                unknown = isUnknownDate(date);
+            }
+
+            if (unknown)
+            {
+                if (stats)
+                    stats->filtered.add(date);
+                continue;
+            }
+
+            std::optional<float> dateNumeric;
+            {
+                // Deserialize the dates into floats
+                IngestStats::Timer timer(stats, IngestStats::DateParse);
+                dateNumeric = dates.getYear(date);
+            }
+
+            if (!dateNumeric)
+            {
+                // We did everything we could, but alas the date is too poorly
+                // formatted and we must move on
+                if (stats)
+                    stats->unparseable.add(date);
+                continue;
+            }
+
+            IngestStats::Timer timer(stats, IngestStats::Construct);
+            objects.add(objectId, name, artist, country, *dateNumeric);
+
+            if (stats)
+                ++stats->objects;
+        }
+    }
+
+    /**
+     * Split a CSV document into ranges that each start at the beginning of a record
+     *
+     * A line break only ends a record if it is preceded by an even number of quotes
+     * in the document, so the quotes in each evenly sized slice are counted in parallel
+     * first to know the quote parity at the start of each slice
+     *
+     * @param begin The start of the document
+     * @param end The end of the document
+     * @param count The desired number of ranges
+     * @param threads The number of threads to count quotes with
+     * @param lines Set to the number of lines before each range, so errors can name the line of the file
+     * @return The start of each range, followed by {end}
+     */
+    static std::vector<const char *> findRecordBoundaries(const char *begin, const char *end, std::size_t count, unsigned threads, std::vector<unsigned> &lines)
+    {
+        std::vector<const char *> slices(count + 1);
+        for (std::size_t i = 0; i <= count; ++i)
+            slices[i] = begin + (end - begin) * i / count;
+
+        std::vector<std::size_t> quotes(count), newlines(count);
+        parallelFor(count, threads, [&](std::size_t i)
+        {
+            quotes[i] = io::detail::count_byte(slices[i], slices[i + 1], '"');
+            newlines[i] = io::detail::count_byte(slices[i], slices[i + 1], '\n');
+        });
+
+        std::vector<const char *> boundaries{begin};
+        lines.assign(1, 0);
+        std::size_t parity = 0, line = 0;
+
+        for (std::size_t i = 1; i < count; ++i)
+        {
+            parity += quotes[i - 1];
+            line += newlines[i - 1];
+
+            // Advance to just past the first line break outside of an escaped string
+            auto cut = slices[i];
+            auto cutParity = parity;
+            auto cutLine = line;
+            while (cut != end)
+            {
+                auto c = *cut++;
+                if (c == '"')
+                    ++cutParity;
+                else if (c == '\n')
+                {
+                    ++cutLine;
+                    if (cutParity % 2 == 0)
+                        break;
+                }
+            }
+
+            if (cut > boundaries.back() && cut != end)
+            {
+                boundaries.push_back(cut);
+                lines.push_back((unsigned) cutLine);
+            }
+        }
+
+        boundaries.push_back(end);
+        return boundaries;
+    }
+
+    static ObjectTable loadParallel(const std::string &path, const char *begin, const char *end, unsigned threads, DateCache &dates, IngestStats *stats)
+    {
+        reader header(path, begin, end);
+        readHeader(header);
+
+        std::vector<const char *> boundaries;
+        std::vector<unsigned> lines;
+        {
+            // Use more chunks than threads so a slow chunk doesn't leave the other threads idle
+            IngestStats::Timer timer(stats, IngestStats::Read);
+            boundaries = findRecordBoundaries(begin, end, (std::size_t) threads * 4, threads, lines);
+        }
+
+        auto chunkCount = boundaries.size() - 1;
+
+        std::vector<ObjectTable> chunks(chunkCount);
+        std::vector<IngestStats> chunkStats(stats ? chunkCount : 0);
+        parallelFor(chunkCount, threads, [&](std::size_t i)
+        {
+            reader in(path, boundaries[i], boundaries[i + 1]);
+
+            // The first chunk starts with the header, the others adopt it and
+            // carry on counting lines from where the previous chunk stopped
+            if (i == 0)
+                readHeader(in);
+            else
+            {
+                in.copy_header(header);
+                in.set_file_line(lines[i]);
+            }
+
+            readObjects(in, chunks[i], dates, stats ? &chunkStats[i] : nullptr);
+        });
+
+        if (stats)
+            for (const auto &s: chunkStats)
+                stats->merge(s);
+
+        IngestStats::Timer timer(stats, IngestStats::Construct);
+
+        std::size_t rows = 0, text = 0;
+        for (const auto &chunk: chunks)
+        {
+            rows += chunk.size();
+            text += chunk.textSize();
+        }
+
+        ObjectTable objects;
+        objects.reserve(rows, text);
+
+        for (auto &chunk: chunks)
+        {
+            objects.append(chunk);
+            chunk = ObjectTable();
+        }
+
+        return objects;
+    }
+
+    /**
+     * A row travelling through the ingest pipeline
+     */
+    struct PipelineRow
+    {
+        std::string objectId, isHighlight, name, artist, country, date;
+        float year = 0;
+        bool usable = false;
+    };
+
+    /**
+     * Records travelling from the read stage to the split stage. The line of the file each
+     * record ends on travels with it, as the reader has moved on by the time it is split
+     */
+    struct RecordBatch
+    {
+        std::vector<std::string> records;
+        std::vector<unsigned> lines;
+    };
+
+    typedef std::vector<PipelineRow> RowBatch;
+
+    static constexpr std::size_t pipelineBatchSize = 1024;
+    static constexpr std::size_t pipelineQueueCapacity = 16;
+
+    /**
+     * Load the dataset through a pipeline of stages, each on its own thread(s) and connected by
+     * bounded queues, so loading takes as long as the slowest stage instead of the sum of them:
+     * <ol>
+     *     <li>Read: cut the file into records</li>
+     *     <li>Split: split the records into columns</li>
+     *     <li>Filter: drop rows whose date is obviously unknown</li>
+     *     <li>Date: convert the dates, spread over {dateWorkers} threads</li>
+     *     <li>Append: add the rows to the table, on the calling thread</li>
+     * </ol>
+     * Rows travel in batches. Batch n goes to date worker n % dateWorkers and the append stage
+     * takes the batches back from the workers in the same order, so the table keeps the file order
+     */
+    static ObjectTable loadPipelined(const std::string &path, unsigned dateWorkers, DateCache &dates, IngestStats *stats)
+    {
+        reader in(path);
+        readHeader(in);
+
+        BoundedQueue<RecordBatch> records(pipelineQueueCapacity);
+        BoundedQueue<RowBatch> split(pipelineQueueCapacity);
+        std::vector<std::unique_ptr<BoundedQueue<RowBatch>>> filtered, converted;
+
+        for (unsigned i = 0; i < dateWorkers; ++i)
+        {
+            filtered.push_back(std::make_unique<BoundedQueue<RowBatch>>(pipelineQueueCapacity));
+            converted.push_back(std::make_unique<BoundedQueue<RowBatch>>(pipelineQueueCapacity));
+        }
+
+        // Every stage thread keeps its own stats: read, split, filter, the date workers and append
+        std::vector<IngestStats> stageStats(stats ? 4 + dateWorkers : 0);
+        auto getStats = [&](std::size_t stage)
+        {
+            return stats ? &stageStats[stage] : nullptr;
+        };
+
+        std::exception_ptr error;
+        std::mutex errorLock;
+
+        // Keep the first failure and unblock every other stage
+        auto fail = [&]()
+        {
+            {
+                std::lock_guard<std::mutex> lock(errorLock);
+                if (!error)
+                    error = std::current_exception();
+            }
+
+            records.cancel();
+            split.cancel();
+            for (unsigned i = 0; i < dateWorkers; ++i)
+            {
+                filtered[i]->cancel();
+                converted[i]->cancel();
+            }
+        };
+
+        std::vector<std::thread> stages;
+
+        auto startStage = [&](auto stage)
+        {
+            stages.emplace_back([&fail, stage]()
+                                {
+                                    try
+                                    {
+                                        stage();
+                                    }
+                                    catch (...)
+                                    {
+                                        fail();
+                                    }
+                                });
+        };
+
+        startStage([&]()
+                   {
+                       auto readStats = getStats(0);
+                       RecordBatch batch;
+                       std::string record;
+
+                       while (true)
+                       {
+                           {
+                               IngestStats::Timer timer(readStats, IngestStats::Read);
+                               if (!in.read_record(record))
+                                   break;
+                           }
+
+                           if (readStats)
+                           {
+                               ++readStats->rows;
+                               readStats->bytes += record.size() + 1;
+                           }
+
+                           batch.records.push_back(std::move(record));
+                           batch.lines.push_back(in.get_file_line());
+                           if (batch.records.size() == pipelineBatchSize && !records.push(std::exchange(batch, {})))
+                               return;
+                       }
+
+                       if (!batch.records.empty() && !records.push(std::move(batch)))
+                           return;
+
+                       records.close();
+                   });
+
+        startStage([&]()
+                   {
+                       auto splitStats = getStats(1);
+                       RecordBatch batch;
+
+                       while (records.pop(batch))
+                       {
+                           RowBatch rows(batch.records.size());
+                           {
+                               IngestStats::Timer timer(splitStats, IngestStats::Split);
+                               for (std::size_t i = 0; i < batch.records.size(); ++i)
+                               {
+                                   auto &r = rows[i];
+                                   try
+                                   {
+                                       in.parse_record(batch.records[i].data(), r.objectId, r.isHighlight, r.name, r.artist, r.country, r.date);
+                                   }
+                                   catch (io::error::with_file_line &err)
+                                   {
+                                       err.set_file_line((int) batch.lines[i]);
+                                       throw;
+                                   }
+                               }
+                           }
+
+                           if (!split.push(std::move(rows)))
+                               return;
+                       }
+
+                       split.close();
+                   });
+
+        startStage([&]()
+                   {
+                       auto filterStats = getStats(2);
+                       RowBatch batch;
+
+                       for (std::size_t sequence = 0; split.pop(batch); ++sequence)
+                       {
+                           {
+                               IngestStats::Timer timer(filterStats, IngestStats::Filter);
+                               batch.erase(std::remove_if(batch.begin(), batch.end(), [&](const PipelineRow &r)
+                               {
+                                   if (!isUnknownDate(r.date))
+                                       return false;
+
+                                   if (filterStats)
+                                       filterStats->filtered.add(r.date);
+                                   return true;
+                               }), batch.end());
+                           }
+
+                           if (!filtered[sequence % dateWorkers]->push(std::move(batch)))
+                               return;
+                       }
+
+                       for (unsigned i = 0; i < dateWorkers; ++i)
+                           filtered[i]->close();
+                   });
+
+        for (unsigned worker = 0; worker < dateWorkers; ++worker)
+            startStage([&, worker]()
+                       {
+                           auto dateStats = getStats(3 + worker);
+                           RowBatch batch;
+
+                           while (filtered[worker]->pop(batch))
+                           {
+                               IngestStats::Timer timer(dateStats, IngestStats::DateParse);
+                               for (auto &r: batch)
+                               {
+                                   auto year = dates.getYear(r.date);
+                                   if (year)
+                                   {
+                                       r.year = *year;
+                                       r.usable = true;
+                                   }
+                                   else if (dateStats)
+                                   {
+                                       // The date is too poorly formatted, the row is dropped while appending
+                                       dateStats->unparseable.add(r.date);
+                                   }
+                               }
+
+                               if (!converted[worker]->push(std::move(batch)))
+                                   return;
+                           }
+
+                           converted[worker]->close();
+                       });
+
+        ObjectTable objects;
+
+        try
+        {
+            auto appendStats = getStats(3 + dateWorkers);
+            RowBatch batch;
+
+            for (std::size_t sequence = 0; converted[sequence % dateWorkers]->pop(batch); ++sequence)
+            {
+                IngestStats::Timer timer(appendStats, IngestStats::Construct);
+                for (const auto &r: batch)
+                    if (r.usable)
+                    {
+                        objects.add(r.objectId, r.name, r.artist, r.country, r.year);
+
+                        if (appendStats)
+                            ++appendStats->objects;
+                    }
+            }
+        }
+        catch (...)
+        {
+            fail();
+        }
+
+        for (auto &t: stages)
+            t.join();
+
+        if (error)
+            std::rethrow_exception(error);
+
+        if (stats)
+            for (const auto &s: stageStats)
+                stats->merge(s);
+
+        return objects;
+    }
+};
+
+#endif //THEMET_MUSEUMOBJECTLOADER_H
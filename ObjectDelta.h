@@ -0,0 +1,36 @@
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <vector>
+#include "ObjectTable.h"
+
+#ifndef THEMET_OBJECTDELTA_H
+#define THEMET_OBJECTDELTA_H
+
+/**
+ * A batch of changes to the objects of a dataset, as published in a delta file
+ *
+ * A delta file is a CSV file with the dataset's columns and one more, "Change", which
+ * is "added", "changed" or "removed". Added and changed objects replace every object
+ * with their object number, and removed objects (tombstones) only need their object
+ * number. An added or changed object whose date can't be used is removed, as it would
+ * have been left out of the dataset.
+ */
+struct ObjectDelta
+{
+    struct Change
+    {
+        std::string objectId;
+
+        // The object's row in {objects}, or nothing if the object is removed
+        std::optional<std::uint32_t> row;
+    };
+
+    // The added and changed objects
+    ObjectTable objects;
+
+    // Every change, in the order of the delta file
+    std::vector<Change> changes;
+};
+
+#endif //THEMET_OBJECTDELTA_H
@@ -0,0 +1,390 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <limits>
+#include <span>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <vector>
+#include "csv.h"
+#include "FileLayout.h"
+#include "MuseumObjectLoader.h"
+#include "ObjectTable.h"
+#include "StringDictionary.h"
+
+#ifndef THEMET_OBJECTSNAPSHOT_H
+#define THEMET_OBJECTSNAPSHOT_H
+
+/**
+ * Caches the objects loaded from a CSV dataset in a compact binary file next to it,
+ * so later runs can skip parsing the CSV and its dates entirely
+ *
+ * The snapshot is keyed on the dataset's path, size, modification time and content
+ * hash. A snapshot whose size or hash doesn't match is rebuilt, and one whose
+ * modification time doesn't match only has its content hash checked again.
+ *
+ * The snapshot holds the columns of the ObjectTable as they are laid out in memory,
+ * in host byte order:
+ * <ol>
+ *     <li>Header</li>
+ *     <li>Dataset path, padded to a multiple of 8 bytes</li>
+ *     <li>Object ID text spans</li>
+ *     <li>Name text spans</li>
+ *     <li>Artist IDs</li>
+ *     <li>Country IDs</li>
+ *     <li>Dates</li>
+ *     <li>A text span per artist in the artist dictionary, in ID order</li>
+ *     <li>A text span per country in the country dictionary, in ID order</li>
+ *     <li>The table's text pool, followed by the text of the dictionaries</li>
+ * </ol>
+ */
+class ObjectSnapshot
+{
+public:
+    /**
+     * Load the objects of a dataset from its snapshot, (re)building the snapshot first if needed
+     * @param csvPath The path to the CSV dataset
+     * @param options How to load the CSV if the snapshot needs to be built
+     * @param rebuild True to rebuild the snapshot even if it is up to date
+     * @return The objects, in the order they appear in the dataset
+     */
+    static ObjectTable loadOrBuild(const std::string &csvPath, const MuseumObjectLoader::Options &options, bool rebuild)
+    {
+#ifdef CSV_IO_MMAP
+        std::error_code error;
+        auto canonicalPath = std::filesystem::canonical(csvPath, error).string();
+
+        // Only regular files have a stable identity to key a snapshot on
+        if (error || !std::filesystem::is_regular_file(canonicalPath, error))
+            return MuseumObjectLoader::load(csvPath, options);
+
+        Key key{canonicalPath, std::filesystem::file_size(canonicalPath), getModifiedTime(canonicalPath), 0};
+        auto snapshotPath = csvPath + ".snapshot";
+
+        if (!rebuild)
+        {
+            auto start = std::chrono::steady_clock::now();
+
+            ObjectTable objects;
+            if (tryLoad(snapshotPath, key, objects))
+            {
+                if (options.stats)
+                {
+                    options.stats->source = "snapshot";
+                    options.stats->wallTime = std::chrono::steady_clock::now() - start;
+                    options.stats->objects = objects.size();
+                }
+
+                return objects;
+            }
+        }
+
+        auto objects = MuseumObjectLoader::load(csvPath, options);
+
+        key.hash = hashFile(canonicalPath);
+        write(snapshotPath, key, objects);
+
+        return objects;
+#else
+        return MuseumObjectLoader::load(csvPath, options);
+#endif
+    }
+
+private:
+    static constexpr char magic[8] = {'M', 'E', 'T', 'S', 'N', 'A', 'P', '\0'};
+
+    // Bump whenever the layout or the way objects are loaded from the dataset changes
+    static constexpr std::uint32_t version = 3;
+
+    typedef ObjectTable::TextSpan TextSpan;
+
+    struct Key
+    {
+        std::string path;
+        std::uint64_t size;
+        std::int64_t modified;
+        std::uint64_t hash;
+    };
+
+    struct Header
+    {
+        char magic[8];
+        std::uint32_t version;
+        std::uint32_t pathLength;
+        std::uint64_t csvSize;
+        std::int64_t csvModified;
+        std::uint64_t csvHash;
+        std::uint64_t rowCount;
+        std::uint32_t artistCount;
+        std::uint32_t countryCount;
+        std::uint64_t tableTextSize;
+        std::uint64_t dictionaryTextSize;
+    };
+
+    static std::int64_t getModifiedTime(const std::string &path)
+    {
+        return std::filesystem::last_write_time(path).time_since_epoch().count();
+    }
+
+    static std::size_t pad(std::size_t length)
+    {
+        return (length + 7) & ~(std::size_t) 7;
+    }
+
+    /**
+     * Hashes a file's contents 8 bytes at a time
+     * @param path The file to hash
+     * @return The hash, or 0 for files that can't be mapped
+     */
+    static std::uint64_t hashFile(const std::string &path)
+    {
+#ifdef CSV_IO_MMAP
+        auto mapping = io::detail::MappedFile::open(path.c_str());
+        if (!mapping)
+            return 0;
+
+        auto data = mapping->data();
+        auto size = mapping->size();
+
+        std::uint64_t hash = 0xcbf29ce484222325ull ^ size;
+        std::size_t i = 0;
+
+        for (; i + 8 <= size; i += 8)
+        {
+            std::uint64_t word;
+            std::memcpy(&word, data + i, 8);
+            hash = (hash ^ word) * 0x100000001b3ull;
+            hash ^= hash >> 29;
+        }
+
+        for (; i < size; ++i)
+            hash = (hash ^ (unsigned char) data[i]) * 0x100000001b3ull;
+
+        return hash;
+#else
+        return 0;
+#endif
+    }
+
+    /**
+     * Load the objects from a snapshot if it is valid and matches the dataset
+     * @param snapshotPath The snapshot file
+     * @param key The dataset's key, without its hash
+     * @param objects The empty table to fill, which may be left partly filled if the snapshot is rejected
+     * @return True if the objects were loaded
+     */
+    static bool tryLoad(const std::string &snapshotPath, Key &key, ObjectTable &objects)
+    {
+#ifdef CSV_IO_MMAP
+        auto mapping = io::detail::MappedFile::open(snapshotPath.c_str());
+        if (!mapping || mapping->size() < sizeof(Header))
+            return false;
+
+        auto data = mapping->data();
+        auto size = mapping->size();
+
+        Header header{};
+        std::memcpy(&header, data, sizeof(Header));
+
+        if (std::memcmp(header.magic, magic, sizeof(magic)) != 0 || header.version != version)
+            return false;
+
+        // Lay the sections out with checked arithmetic, so corrupt counts can't wrap around to the file's size
+        auto rows = header.rowCount;
+        FileLayout layout{sizeof(Header)};
+        layout.add(pad(header.pathLength), 1);
+        auto objectIdsOffset = layout.add(rows, sizeof(TextSpan));
+        auto namesOffset = layout.add(rows, sizeof(TextSpan));
+        auto artistIdsOffset = layout.add(rows, sizeof(std::uint32_t));
+        auto countryIdsOffset = layout.add(rows, sizeof(std::uint32_t));
+        auto datesOffset = layout.add(rows, sizeof(float));
+        auto artistsOffset = layout.add(header.artistCount, sizeof(TextSpan));
+        auto countriesOffset = layout.add(header.countryCount, sizeof(TextSpan));
+        auto textOffset = layout.add(header.tableTextSize, 1);
+        layout.add(header.dictionaryTextSize, 1);
+
+        if (layout.overflowed || layout.size != size)
+            return false;
+
+        if (std::string_view(data + sizeof(Header), header.pathLength) != key.path || header.csvSize != key.size)
+            return false;
+
+        if (header.csvModified != key.modified)
+        {
+            // The dataset was touched, but it may still have the same contents
+            key.hash = hashFile(key.path);
+            if (header.csvHash != key.hash)
+                return false;
+
+            header.csvModified = key.modified;
+            updateHeader(snapshotPath, header);
+        }
+
+        auto text = data + textOffset;
+        auto textSize = header.tableTextSize + header.dictionaryTextSize;
+
+        auto spansOf = [&](std::size_t offset, std::size_t count)
+        {
+            return std::span(reinterpret_cast<const TextSpan *>(data + offset), count);
+        };
+
+        auto idsOf = [&](std::size_t offset)
+        {
+            return std::span(reinterpret_cast<const std::uint32_t *>(data + offset), rows);
+        };
+
+        // Every span and dictionary ID is used without further checks, so make sure none leads out of bounds
+        auto spansFit = [](std::span<const TextSpan> spans, std::uint64_t size)
+        {
+            return std::all_of(spans.begin(), spans.end(), [&](const TextSpan &span)
+            {
+                return (std::uint64_t) span.offset + span.length <= size;
+            });
+        };
+
+        auto idsFit = [](std::span<const std::uint32_t> ids, std::uint32_t count)
+        {
+            return std::all_of(ids.begin(), ids.end(), [&](std::uint32_t id)
+            {
+                return id < count;
+            });
+        };
+
+        if (!spansFit(spansOf(objectIdsOffset, rows), header.tableTextSize) || !spansFit(spansOf(namesOffset, rows), header.tableTextSize))
+            return false;
+
+        if (!spansFit(spansOf(artistsOffset, header.artistCount), textSize) || !spansFit(spansOf(countriesOffset, header.countryCount), textSize))
+            return false;
+
+        if (!idsFit(idsOf(artistIdsOffset), header.artistCount) || !idsFit(idsOf(countryIdsOffset), header.countryCount))
+            return false;
+
+        auto loadColumn = [&](auto &column, std::size_t offset)
+        {
+            typedef typename std::remove_reference_t<decltype(column)>::value_type value_type;
+            auto begin = reinterpret_cast<const value_type *>(data + offset);
+            column.assign(begin, begin + rows);
+        };
+
+        loadColumn(objects._objectIds, objectIdsOffset);
+        loadColumn(objects._names, namesOffset);
+        loadColumn(objects._artistIds, artistIdsOffset);
+        loadColumn(objects._countryIds, countryIdsOffset);
+        loadColumn(objects._dates, datesOffset);
+        objects._text.assign(text, header.tableTextSize);
+
+        // Interning the strings in ID order reproduces the IDs they were saved with, unless the
+        // snapshot repeats a string, which would shift every later ID
+        auto loadDictionary = [&](StringDictionary &dictionary, std::size_t offset, std::uint32_t count)
+        {
+            for (const auto &span: spansOf(offset, count))
+                dictionary.intern(std::string_view(text + span.offset, span.length));
+
+            return dictionary.size() == count;
+        };
+
+        if (!loadDictionary(objects._artists, artistsOffset, header.artistCount) || !loadDictionary(objects._countries, countriesOffset, header.countryCount))
+            return false;
+
+        return true;
+#else
+        return false;
+#endif
+    }
+
+    static void updateHeader(const std::string &snapshotPath, const Header &header)
+    {
+        std::fstream file(snapshotPath, std::ios::in | std::ios::out | std::ios::binary);
+        file.write(reinterpret_cast<const char *>(&header), sizeof(Header));
+    }
+
+    /**
+     * Write a snapshot, replacing any existing one only once it has been written completely.
+     * Failing to write a snapshot (e.g. in a read-only directory) isn't an error, it
+     * just means the next run has to parse the dataset again
+     * @param snapshotPath The snapshot file
+     * @param key The dataset's key
+     * @param objects The objects loaded from the dataset
+     */
+    static void write(const std::string &snapshotPath, const Key &key, const ObjectTable &objects)
+    {
+        // The dictionaries' text follows the table's text pool
+        std::string dictionaryText;
+
+        auto addDictionary = [&](const StringDictionary &dictionary)
+        {
+            std::vector<TextSpan> spans;
+            for (std::uint32_t i = 0; i < dictionary.size(); ++i)
+            {
+                const auto &s = dictionary.lookup(i);
+                spans.push_back(TextSpan{(std::uint32_t) (objects._text.size() + dictionaryText.size()), (std::uint32_t) s.size()});
+                dictionaryText.append(s);
+            }
+            return spans;
+        };
+
+        auto artists = addDictionary(objects._artists);
+        auto countries = addDictionary(objects._countries);
+
+        if (objects._text.size() + dictionaryText.size() > std::numeric_limits<std::uint32_t>::max())
+            return;
+
+        Header header{};
+        std::memcpy(header.magic, magic, sizeof(magic));
+        header.version = version;
+        header.pathLength = (std::uint32_t) key.path.size();
+        header.csvSize = key.size;
+        header.csvModified = key.modified;
+        header.csvHash = key.hash;
+        header.rowCount = objects.size();
+        header.artistCount = (std::uint32_t) artists.size();
+        header.countryCount = (std::uint32_t) countries.size();
+        header.tableTextSize = objects._text.size();
+        header.dictionaryTextSize = dictionaryText.size();
+
+        auto temporaryPath = snapshotPath + ".tmp";
+
+        {
+            std::ofstream file(temporaryPath, std::ios::binary | std::ios::trunc);
+            if (!file)
+                return;
+
+            auto writeColumn = [&](const auto &column)
+            {
+                file.write(reinterpret_cast<const char *>(column.data()), (std::streamsize) (column.size() * sizeof(column[0])));
+            };
+
+            std::string path = key.path;
+            path.resize(pad(path.size()), '\0');
+
+            file.write(reinterpret_cast<const char *>(&header), sizeof(Header));
+            file.write(path.data(), (std::streamsize) path.size());
+            writeColumn(objects._objectIds);
+            writeColumn(objects._names);
+            writeColumn(objects._artistIds);
+            writeColumn(objects._countryIds);
+            writeColumn(objects._dates);
+            writeColumn(artists);
+            writeColumn(countries);
+            file.write(objects._text.data(), (std::streamsize) objects._text.size());
+            file.write(dictionaryText.data(), (std::streamsize) dictionaryText.size());
+
+            if (!file)
+            {
+                file.close();
+                std::remove(temporaryPath.c_str());
+                return;
+            }
+        }
+
+        std::error_code error;
+        std::filesystem::rename(temporaryPath, snapshotPath, error);
+    }
+};
+
+#endif //THEMET_OBJECTSNAPSHOT_H
@@ -0,0 +1,326 @@
+#include <cstdint>
+#include <iterator>
+#include <limits>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "MuseumObject.h"
+#include "StringDictionary.h"
+
+#ifndef THEMET_OBJECTTABLE_H
+#define THEMET_OBJECTTABLE_H
+
+/**
+ * Stores museum objects column by column, so a scan over one attribute (e.g. the dates)
+ * only touches that attribute's memory
+ *
+ * Object IDs and names are kept back to back in one shared text pool and referenced by
+ * offset, while artists and countries are interned into dictionaries and stored as IDs.
+ */
+class ObjectTable
+{
+public:
+    /**
+     * A run of characters in the table's text pool
+     */
+    struct TextSpan
+    {
+        std::uint32_t offset;
+        std::uint32_t length;
+    };
+
+    /**
+     * A lightweight view of one row of the table
+     */
+    class Row
+    {
+    private:
+        const ObjectTable *_table;
+        std::uint32_t _index;
+
+    public:
+        Row(const ObjectTable *table, std::uint32_t index) : _table(table), _index(index)
+        {}
+
+        [[nodiscard]] std::uint32_t index() const
+        {
+            return _index;
+        }
+
+        [[nodiscard]] std::string_view objectId() const
+        {
+            return _table->getText(_table->_objectIds[_index]);
+        }
+
+        [[nodiscard]] std::string_view name() const
+        {
+            return _table->getText(_table->_names[_index]);
+        }
+
+        [[nodiscard]] std::uint32_t artistId() const
+        {
+            return _table->_artistIds[_index];
+        }
+
+        [[nodiscard]] std::uint32_t countryId() const
+        {
+            return _table->_countryIds[_index];
+        }
+
+        [[nodiscard]] const std::string &artist() const
+        {
+            return _table->_artists.lookup(artistId());
+        }
+
+        [[nodiscard]] const std::string &country() const
+        {
+            return _table->_countries.lookup(countryId());
+        }
+
+        [[nodiscard]] float date() const
+        {
+            return _table->_dates[_index];
+        }
+
+        /**
+         * Copies the row into a standalone MuseumObject, e.g. to insert it into a graph
+         */
+        [[nodiscard]] MuseumObject toObject() const
+        {
+            return {std::string(objectId()), std::string(name()), artistId(), countryId(), date()};
+        }
+    };
+
+    class iterator
+    {
+    private:
+        const ObjectTable *_table;
+        std::uint32_t _index;
+
+    public:
+        typedef std::ptrdiff_t difference_type;
+        typedef Row value_type;
+        typedef Row reference;
+        typedef std::input_iterator_tag iterator_category;
+
+        iterator(const ObjectTable *table, std::uint32_t index) : _table(table), _index(index)
+        {}
+
+        Row operator*() const
+        {
+            return {_table, _index};
+        }
+
+        iterator &operator++()
+        {
+            ++_index;
+            return *this;
+        }
+
+        iterator operator++(int)
+        {
+            auto copy = *this;
+            ++_index;
+            return copy;
+        }
+
+        bool operator==(const iterator &rhs) const
+        {
+            return _index == rhs._index;
+        }
+
+        bool operator!=(const iterator &rhs) const
+        {
+            return _index != rhs._index;
+        }
+    };
+
+private:
+    std::string _text;
+    std::vector<TextSpan> _objectIds;
+    std::vector<TextSpan> _names;
+    std::vector<std::uint32_t> _artistIds;
+    std::vector<std::uint32_t> _countryIds;
+    std::vector<float> _dates;
+
+    StringDictionary _artists;
+    StringDictionary _countries;
+
+    friend class ObjectSnapshot;
+
+    [[nodiscard]] std::string_view getText(const TextSpan &span) const
+    {
+        return {_text.data() + span.offset, span.length};
+    }
+
+    TextSpan addText(std::string_view s)
+    {
+        if (_text.size() + s.size() > std::numeric_limits<std::uint32_t>::max())
+            throw std::length_error("Object table text pool is full");
+
+        TextSpan span{(std::uint32_t) _text.size(), (std::uint32_t) s.size()};
+        _text.append(s);
+        return span;
+    }
+
+public:
+    /**
+     * Append an object to the table
+     * @param objectId The object's accession number
+     * @param name The object's title
+     * @param artist The object's artist
+     * @param country The object's country of origin
+     * @param date The object's deserialized date
+     */
+    void add(std::string_view objectId, std::string_view name, std::string_view artist, std::string_view country, float date)
+    {
+        _objectIds.push_back(addText(objectId));
+        _names.push_back(addText(name));
+        _artistIds.push_back(_artists.intern(artist));
+        _countryIds.push_back(_countries.intern(country));
+        _dates.push_back(date);
+    }
+
+    /**
+     * Append all of the rows of another table, in order
+     * @param other The table to append
+     */
+    void append(const ObjectTable &other)
+    {
+        if (_text.size() + other._text.size() > std::numeric_limits<std::uint32_t>::max())
+            throw std::length_error("Object table text pool is full");
+
+        auto textOffset = (std::uint32_t) _text.size();
+        _text.append(other._text);
+
+        auto artistIds = _artists.merge(other._artists);
+        auto countryIds = _countries.merge(other._countries);
+
+        for (std::uint32_t i = 0; i < other.size(); ++i)
+        {
+            _objectIds.push_back(TextSpan{other._objectIds[i].offset + textOffset, other._objectIds[i].length});
+            _names.push_back(TextSpan{other._names[i].offset + textOffset, other._names[i].length});
+            _artistIds.push_back(artistIds[other._artistIds[i]]);
+            _countryIds.push_back(countryIds[other._countryIds[i]]);
+        }
+
+        _dates.insert(_dates.end(), other._dates.begin(), other._dates.end());
+    }
+
+    /**
+     * Remove a row by moving the last row into its place. The text of the removed row
+     * stays in the text pool until the table is rebuilt
+     * @param index The row to remove
+     */
+    void remove(std::uint32_t index)
+    {
+        auto last = size() - 1;
+
+        _objectIds[index] = _objectIds[last];
+        _names[index] = _names[last];
+        _artistIds[index] = _artistIds[last];
+        _countryIds[index] = _countryIds[last];
+        _dates[index] = _dates[last];
+
+        _objectIds.pop_back();
+        _names.pop_back();
+        _artistIds.pop_back();
+        _countryIds.pop_back();
+        _dates.pop_back();
+    }
+
+    /**
+     * Reserve space for a number of rows and characters of text
+     */
+    void reserve(std::size_t rows, std::size_t text)
+    {
+        _text.reserve(text);
+        _objectIds.reserve(rows);
+        _names.reserve(rows);
+        _artistIds.reserve(rows);
+        _countryIds.reserve(rows);
+        _dates.reserve(rows);
+    }
+
+    [[nodiscard]] std::uint32_t size() const
+    {
+        return (std::uint32_t) _dates.size();
+    }
+
+    [[nodiscard]] std::size_t textSize() const
+    {
+        return _text.size();
+    }
+
+    [[nodiscard]] bool empty() const
+    {
+        return _dates.empty();
+    }
+
+    Row operator[](std::uint32_t index) const
+    {
+        return {this, index};
+    }
+
+    [[nodiscard]] iterator begin() const
+    {
+        return {this, 0};
+    }
+
+    [[nodiscard]] iterator end() const
+    {
+        return {this, size()};
+    }
+
+    /**
+     * The date column
+     */
+    [[nodiscard]] const std::vector<float> &dates() const
+    {
+        return _dates;
+    }
+
+    /**
+     * The artist ID column
+     */
+    [[nodiscard]] const std::vector<std::uint32_t> &artistIds() const
+    {
+        return _artistIds;
+    }
+
+    /**
+     * The country ID column
+     */
+    [[nodiscard]] const std::vector<std::uint32_t> &countryIds() const
+    {
+        return _countryIds;
+    }
+
+    [[nodiscard]] const StringDictionary &artists() const
+    {
+        return _artists;
+    }
+
+    [[nodiscard]] const StringDictionary &countries() const
+    {
+        return _countries;
+    }
+};
+
+inline const std::vector<MuseumObjectArtistComparator::key_type> &MuseumObjectArtistComparator::keys(const ObjectTable &objects)
+{
+    return objects.artistIds();
+}
+
+inline const std::vector<MuseumObjectLocationComparator::key_type> &MuseumObjectLocationComparator::keys(const ObjectTable &objects)
+{
+    return objects.countryIds();
+}
+
+inline const std::vector<MuseumObjectDateComparator::key_type> &MuseumObjectDateComparator::keys(const ObjectTable &objects)
+{
+    return objects.dates();
+}
+
+#endif //THEMET_OBJECTTABLE_H
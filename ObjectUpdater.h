@@ -0,0 +1,85 @@
+#include <algorithm>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include "ObjectDelta.h"
+#include "ObjectTable.h"
+
+#ifndef THEMET_OBJECTUPDATER_H
+#define THEMET_OBJECTUPDATER_H
+
+/**
+ * Applies deltas to a table of objects, in time proportional to the size of the delta
+ *
+ * The rows of each object number are indexed once, when the updater is created. Removed
+ * rows are replaced by the last row of the table, so a change moves at most one other
+ * row.
+ */
+class ObjectUpdater
+{
+private:
+    ObjectTable *_objects;
+    std::unordered_map<std::string, std::vector<std::uint32_t>> _rowsById;
+
+public:
+    /**
+     * Index a table of objects, which must outlive the updater and only be changed through it
+     * @param objects The objects
+     */
+    explicit ObjectUpdater(ObjectTable &objects) : _objects(&objects)
+    {
+        _rowsById.reserve(objects.size());
+        for (std::uint32_t row = 0; row < objects.size(); ++row)
+            _rowsById[std::string(objects[row].objectId())].push_back(row);
+    }
+
+    /**
+     * Apply the changes of a delta to the table, in order
+     * @param delta The delta
+     */
+    void apply(const ObjectDelta &delta)
+    {
+        for (const auto &change: delta.changes)
+        {
+            // Added and changed objects replace every row with their object number
+            remove(change.objectId);
+
+            if (!change.row)
+                continue;
+
+            auto object = delta.objects[*change.row];
+            _objects->add(object.objectId(), object.name(), object.artist(), object.country(), object.date());
+            _rowsById[change.objectId].push_back(_objects->size() - 1);
+        }
+    }
+
+private:
+    void remove(const std::string &id)
+    {
+        auto it = _rowsById.find(id);
+        if (it == _rowsById.end())
+            return;
+
+        // From the last row down, so no row of this object is moved before it's removed
+        auto rows = std::move(it->second);
+        _rowsById.erase(it);
+        std::sort(rows.begin(), rows.end(), std::greater<>());
+
+        for (auto row: rows)
+        {
+            auto last = _objects->size() - 1;
+            _objects->remove(row);
+
+            if (row == last)
+                continue;
+
+            auto &moved = _rowsById.find(std::string((*_objects)[row].objectId()))->second;
+            *std::find(moved.begin(), moved.end(), last) = row;
+        }
+    }
+};
+
+#endif //THEMET_OBJECTUPDATER_H
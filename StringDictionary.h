@@ -0,0 +1,99 @@
+#include <cstdint>
+#include <deque>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#ifndef THEMET_STRINGDICTIONARY_H
+#define THEMET_STRINGDICTIONARY_H
+
+/**
+ * Interns strings, assigning each distinct string a dense 32-bit ID in order of first appearance
+ */
+class StringDictionary
+{
+private:
+    // A deque never moves its elements, so the views in _ids stay valid as it grows
+    std::deque<std::string> _strings;
+    std::unordered_map<std::string_view, std::uint32_t> _ids;
+
+public:
+    StringDictionary() = default;
+
+    StringDictionary(const StringDictionary &) = delete;
+
+    StringDictionary &operator=(const StringDictionary &) = delete;
+
+    StringDictionary(StringDictionary &&) = default;
+
+    StringDictionary &operator=(StringDictionary &&) = default;
+
+    /**
+     * Gets the ID of a string, adding it to the dictionary if it isn't in it yet
+     * @param s The string
+     * @return The ID of the string
+     */
+    std::uint32_t intern(std::string_view s)
+    {
+        auto it = _ids.find(s);
+        if (it != _ids.end())
+            return it->second;
+
+        auto id = (std::uint32_t) _strings.size();
+        _strings.emplace_back(s);
+        _ids.emplace(_strings.back(), id);
+        return id;
+    }
+
+    /**
+     * Interns every string of another dictionary
+     * @param other The dictionary to merge into this one
+     * @return The ID in this dictionary of each of {other}'s IDs
+     */
+    std::vector<std::uint32_t> merge(const StringDictionary &other)
+    {
+        std::vector<std::uint32_t> ids;
+        ids.reserve(other.size());
+
+        for (const auto &s: other._strings)
+            ids.push_back(intern(s));
+
+        return ids;
+    }
+
+    /**
+     * Gets the ID of a string without adding it to the dictionary
+     * @param s The string
+     * @return Optionally, the ID of the string if it is in the dictionary
+     */
+    [[nodiscard]] std::optional<std::uint32_t> find(std::string_view s) const
+    {
+        auto it = _ids.find(s);
+        if (it == _ids.end())
+            return {};
+
+        return it->second;
+    }
+
+    /**
+     * Gets the string with the given ID
+     * @param id The ID, which must have been returned by intern()
+     * @return The string
+     */
+    [[nodiscard]] const std::string &lookup(std::uint32_t id) const
+    {
+        return _strings[id];
+    }
+
+    /**
+     * Gets the number of distinct strings in the dictionary, which is also the next ID to be assigned
+     */
+    [[nodiscard]] std::uint32_t size() const
+    {
+        return (std::uint32_t) _strings.size();
+    }
+};
+
+#endif //THEMET_STRINGDICTIONARY_H
@@ -0,0 +1,140 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <vector>
+#include "../MuseumObjectLoader.h"
+
+using namespace std;
+
+/**
+ * Times the scans csv.h spends most of its time in, over every record of a dataset,
+ * against the plain byte-at-a-time loops they replace:
+ * <ol>
+ *     <li>Finding the end of every column of a record</li>
+ *     <li>Counting the quotes of a record</li>
+ *     <li>Splitting a record into the loader's columns</li>
+ * </ol>
+ * Each is run several times and the best time is reported. Build with optimizations
+ * (e.g. CMAKE_BUILD_TYPE=Release), and with CSV_IO_NO_SIMD to time the scalar versions
+ * of the csv.h scans.
+ *
+ * CsvScanBenchmark <MetObjects.csv> [repetitions]
+ */
+
+static const char *findColumnEndScalar(const char *col_begin)
+{
+    while (true)
+    {
+        while (*col_begin != ',' && *col_begin != '"' && *col_begin != '\0')
+            ++col_begin;
+        if (*col_begin != '"')
+            return col_begin;
+
+        do
+        {
+            ++col_begin;
+            while (*col_begin != '"' && *col_begin != '\0')
+                ++col_begin;
+            if (*col_begin == '\0')
+                return col_begin;
+            ++col_begin;
+        } while (*col_begin == '"');
+    }
+}
+
+template<typename F>
+static double bestOf(unsigned repetitions, F &&fn)
+{
+    auto best = chrono::duration<double>::max();
+
+    for (unsigned i = 0; i < repetitions; ++i)
+    {
+        auto start = chrono::steady_clock::now();
+        fn();
+        best = min(best, chrono::duration<double>(chrono::steady_clock::now() - start));
+    }
+
+    return best.count();
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc < 2)
+    {
+        cerr << "Usage: " << argv[0] << " <MetObjects.csv> [repetitions]" << endl;
+        return EXIT_FAILURE;
+    }
+
+    auto repetitions = argc > 2 ? (unsigned) stoul(argv[2]) : 7u;
+
+    MuseumObjectLoader::reader in(argv[1]);
+    in.read_header(io::ignore_extra_column, "Object Number", "Is Highlight", "Title", "Artist Display Name", "Country", "Object Date");
+
+    vector<string> records;
+    string record;
+    while (in.read_record(record))
+        records.push_back(record);
+
+    typedef io::double_quote_escape<',', '"'> quote_policy;
+
+    // Keep the results alive so the scans aren't optimized away
+    size_t checksum = 0;
+
+    auto findScalar = bestOf(repetitions, [&]()
+    {
+        for (const auto &r: records)
+            for (auto col = r.data();; ++col)
+            {
+                auto end = findColumnEndScalar(col);
+                checksum += end - col;
+                if (*end == '\0')
+                    break;
+                col = end;
+            }
+    });
+
+    auto findCsv = bestOf(repetitions, [&]()
+    {
+        for (const auto &r: records)
+            for (auto col = r.data(), lineEnd = r.data() + r.size();; ++col)
+            {
+                auto end = quote_policy::find_next_column_end(col, lineEnd);
+                checksum += end - col;
+                if (*end == '\0')
+                    break;
+                col = end;
+            }
+    });
+
+    auto countScalar = bestOf(repetitions, [&]()
+    {
+        for (const auto &r: records)
+            checksum += count(r.begin(), r.end(), '"');
+    });
+
+    auto countCsv = bestOf(repetitions, [&]()
+    {
+        for (const auto &r: records)
+            checksum += io::detail::count_byte(r.data(), r.data() + r.size(), '"');
+    });
+
+    string objectId, isHighlight, name, artist, country, date;
+    auto split = bestOf(repetitions, [&]()
+    {
+        auto copy = records;
+        for (auto &r: copy)
+        {
+            in.parse_record(r.data(), objectId, isHighlight, name, artist, country, date);
+            checksum += name.size();
+        }
+    });
+
+    cout << records.size() << " records, best of " << repetitions << " (checksum " << checksum << ")" << endl;
+    cout << "find column ends: " << findScalar << "s scalar, " << findCsv << "s csv.h" << endl;
+    cout << "count quotes:     " << countScalar << "s scalar, " << countCsv << "s csv.h" << endl;
+    cout << "split records:    " << split << "s csv.h" << endl;
+
+    return EXIT_SUCCESS;
+}
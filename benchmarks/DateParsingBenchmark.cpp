@@ -0,0 +1,170 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <regex>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include "../MuseumObject.h"
+
+using namespace std;
+
+/**
+ * Times MuseumObjectDateComparator::getYear against the cascade of regular expressions
+ * it replaces, over the dates of a table like tests/object_dates.tsv
+ *
+ * Every date is parsed once per pass, and the best of several passes is reported for
+ * each, along with the number of dates per second. Build with optimizations (e.g.
+ * CMAKE_BUILD_TYPE=Release).
+ *
+ * DateParsingBenchmark <object_dates.tsv> [repetitions]
+ */
+
+/**
+ * getYear as it was: the first of several regular expressions that matches gives the year
+ */
+static float getYearRegex(const string &s)
+{
+    smatch match;
+
+    auto parsed = false;
+    float year = 0;
+
+    regex regexCentury("(\\d+)..[ –-]+[CcPp]");
+    if (regex_search(s, match, regexCentury, regex_constants::match_any))
+    {
+        year = ((float) stoi(match[1]) - 1) * 100 + 50;
+        parsed = true;
+    }
+
+    regex regexMillennium("(\\d+).. +[Mm]");
+    if (!parsed && regex_search(s, match, regexMillennium, regex_constants::match_any))
+    {
+        year = ((float) stoi(match[1]) - 1) * 1000 + 500;
+        parsed = true;
+    }
+
+    regex regexBC("(\\d+) (B.C.|A.D.)");
+    if (!parsed && regex_search(s, match, regexBC, regex_constants::match_any))
+    {
+        year = (float) stoi(match[1]);
+        parsed = true;
+    }
+
+    regex regexAD("(B.C.|A.D.) (\\d+)");
+    if (!parsed && regex_search(s, match, regexAD, regex_constants::match_any))
+    {
+        year = (float) stoi(match[2]);
+        parsed = true;
+    }
+
+    regex regexPlainYear("(\\d{3,4})");
+    if (!parsed && regex_search(s, match, regexPlainYear, regex_constants::match_any))
+    {
+        year = (float) stoi(match[1]);
+        parsed = true;
+    }
+
+    regex regexHopefullyAYear("(\\d+)");
+    if (!parsed && regex_search(s, match, regexHopefullyAYear, regex_constants::match_any))
+    {
+        year = (float) stoi(match[1]);
+        parsed = true;
+    }
+
+    if (!parsed)
+        throw invalid_argument("Unable to parse date");
+
+    if (s.find("B.C.") != string::npos)
+        year = -year;
+
+    return year;
+}
+
+/**
+ * Parses every date once
+ * @return The sum of the years, and the number of dates that couldn't be parsed
+ */
+template<typename F>
+static pair<double, unsigned> parseAll(const vector<string> &dates, F &&getYear)
+{
+    double sum = 0;
+    unsigned unparseable = 0;
+
+    for (const auto &date: dates)
+    {
+        try
+        {
+            sum += getYear(date);
+        }
+        catch (exception &)
+        {
+            ++unparseable;
+        }
+    }
+
+    return {sum, unparseable};
+}
+
+template<typename F>
+static double bestOf(unsigned repetitions, F &&fn)
+{
+    auto best = chrono::duration<double>::max();
+
+    for (unsigned i = 0; i < repetitions; ++i)
+    {
+        auto start = chrono::steady_clock::now();
+        fn();
+        best = min(best, chrono::duration<double>(chrono::steady_clock::now() - start));
+    }
+
+    return best.count();
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc < 2)
+    {
+        cerr << "Usage: " << argv[0] << " <object_dates.tsv> [repetitions]" << endl;
+        return EXIT_FAILURE;
+    }
+
+    ifstream table(argv[1]);
+    if (!table)
+    {
+        cerr << "Unable to open " << argv[1] << endl;
+        return EXIT_FAILURE;
+    }
+
+    auto repetitions = argc > 2 ? (unsigned) stoul(argv[2]) : 7u;
+
+    // Only the dates are needed, not the years they should parse to
+    vector<string> dates;
+    string line;
+    while (getline(table, line))
+        if (!line.empty() && line[0] != '#')
+            dates.push_back(line.substr(0, line.rfind('\t')));
+
+    pair<double, unsigned> regexResult, scannerResult;
+
+    auto regexTime = bestOf(repetitions, [&]()
+    {
+        regexResult = parseAll(dates, getYearRegex);
+    });
+
+    auto scannerTime = bestOf(repetitions, [&]()
+    {
+        scannerResult = parseAll(dates, [](const string &date)
+        {
+            return MuseumObjectDateComparator::getYear(date);
+        });
+    });
+
+    cout << dates.size() << " dates, best of " << repetitions << endl;
+    cout << "regex:   " << regexTime << "s, " << dates.size() / regexTime << " dates/s (sum " << regexResult.first << ", " << regexResult.second << " unparseable)" << endl;
+    cout << "scanner: " << scannerTime << "s, " << dates.size() / scannerTime << " dates/s (sum " << scannerResult.first << ", " << scannerResult.second << " unparseable)" << endl;
+
+    return regexResult == scannerResult ? EXIT_SUCCESS : EXIT_FAILURE;
+}
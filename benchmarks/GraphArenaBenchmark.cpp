@@ -0,0 +1,132 @@
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+#include <sys/resource.h>
+#include "../MuseumObjectGrouper.h"
+#include "../MuseumObjectLoader.h"
+
+using namespace std;
+
+/**
+ * Times building and freeing the date-grouping graph of a dataset, and reports the peak
+ * resident set size, for one way of building it:
+ * <ol>
+ *     <li>map: std::maps keyed by whole MuseumObjects with addEdge, as graph was before its arena</li>
+ *     <li>addEdge: graph, one addEdge call per pair</li>
+ *     <li>bulk: graph, all pairs at once with addEdges, as fillGraph does</li>
+ * </ol>
+ * The peak is only ever raised, so run each way in its own process. The pairs are
+ * collected before the clock starts, so every way inserts the same pairs in the same
+ * order. Build with optimizations (e.g. CMAKE_BUILD_TYPE=Release).
+ *
+ * GraphArenaBenchmark <MetObjects.csv> <map|addEdge|bulk>
+ */
+
+/**
+ * The graph before its arena: every edge is a node in two maps keyed by whole objects
+ */
+struct MapGraph
+{
+    std::map<std::string, MuseumObject> verticesById;
+    std::map<MuseumObject, std::map<MuseumObject, float>> adjacency;
+
+    void addEdge(const MuseumObject &a, const MuseumObject &b, float weight)
+    {
+        adjacency[a][b] = weight;
+        adjacency[b][a] = weight;
+
+        verticesById[a.objectId] = a;
+        verticesById[b.objectId] = b;
+    }
+};
+
+/**
+ * Takes the pairs a grouper would insert into a graph
+ */
+struct EdgeRecorder
+{
+    vector<graph::edge> edges;
+};
+
+void insertEdges(EdgeRecorder &recorder, const ObjectTable &, const vector<graph::edge> &edges)
+{
+    recorder.edges = edges;
+}
+
+static long peakKilobytes()
+{
+    rusage usage{};
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_maxrss;
+}
+
+template<typename Graph, typename F>
+static void run(F &&build)
+{
+    auto peakBefore = peakKilobytes();
+
+    auto start = chrono::steady_clock::now();
+    auto built = make_unique<Graph>();
+    build(*built);
+    auto buildTime = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+    auto peakAfter = peakKilobytes();
+
+    start = chrono::steady_clock::now();
+    built.reset();
+    auto freeTime = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+    cout << "build " << buildTime << "s, free " << freeTime << "s, peak RSS " << (peakAfter >> 10) << " MB ("
+         << (peakBefore >> 10) << " MB before building)" << endl;
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc != 3)
+    {
+        cerr << "Usage: " << argv[0] << " <MetObjects.csv> <map|addEdge|bulk>" << endl;
+        return EXIT_FAILURE;
+    }
+
+    string mode = argv[2];
+
+    auto objects = MuseumObjectLoader::load(argv[1], {});
+
+    EdgeRecorder recorder;
+    MuseumObjectSweepGrouper<MuseumObjectDateComparator>::groupObjects(dateMaxCost, recorder, objects);
+
+    vector<MuseumObject> vertices(objects.size());
+    for (uint32_t row = 0; row < objects.size(); ++row)
+        vertices[row] = objects[row].toObject();
+
+    cout << objects.size() << " objects, " << recorder.edges.size() << " pairs, " << mode << ": " << flush;
+
+    if (mode == "map")
+        run<MapGraph>([&](MapGraph &built)
+        {
+            for (const auto &e: recorder.edges)
+                built.addEdge(vertices[e.from], vertices[e.to], e.weight);
+        });
+    else if (mode == "addEdge")
+        run<graph>([&](graph &built)
+        {
+            for (const auto &e: recorder.edges)
+                built.addEdge(vertices[e.from], vertices[e.to], e.weight);
+        });
+    else if (mode == "bulk")
+        run<graph>([&](graph &built)
+        {
+            built.addEdges(vertices, recorder.edges);
+        });
+    else
+    {
+        cerr << "Unknown mode " << mode << endl;
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,266 @@
+#include <algorithm>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "FlatIdIndex.h"
+#include "graph.h"
+#include "graph_algorithms.h"
+#include "MuseumObject.h"
+#include "ObjectTable.h"
+
+#ifndef THEMET_CSR_GRAPH_H
+#define THEMET_CSR_GRAPH_H
+
+/**
+ * An immutable graph over the objects of a table, built in bulk from a list of edges
+ * and stored in compressed sparse row form: the neighbors of every vertex lie next to
+ * each other in one array, and vertices are 32-bit indices rather than objects
+ *
+ * It holds the same vertices and edges that graph would after inserting the edges with
+ * addEdges: objects with the same ID are one vertex, objects without edges aren't
+ * vertices, and the last of several edges between two vertices wins. Vertices are
+ * numbered in the order of their IDs, so neighbors are visited in the same order too.
+ *
+ * The table must outlive the graph.
+ */
+class csr_graph
+{
+public:
+    typedef std::uint32_t vertex_type;
+
+    /**
+     * A neighbor of a vertex, and the weight of the edge to it
+     */
+    struct neighbor
+    {
+        vertex_type vertex;
+        float weight;
+    };
+
+private:
+    friend class GraphFile;
+    friend class IncrementalGrouper;
+
+    const ObjectTable *_objects = nullptr;
+
+    // The row of the table each vertex stands for; the first row with its ID
+    std::span<const std::uint32_t> _rows;
+
+    // The neighbors of vertex v are _neighbors[_offsets[v]] to _neighbors[_offsets[v + 1]]
+    std::span<const std::uint64_t> _offsets;
+    std::span<const neighbor> _neighbors;
+
+    // The arrays, if the graph was built rather than mapped from a file
+    std::vector<std::uint32_t> _rowStorage;
+    std::vector<std::uint64_t> _offsetStorage;
+    std::vector<neighbor> _neighborStorage;
+
+    // Keeps the file the arrays were mapped from, if any, mapped
+    std::shared_ptr<const void> _mapping;
+
+    FlatIdIndex _vertexById;
+
+    auto keyOf() const
+    {
+        return [this](vertex_type v)
+        {
+            return id(v);
+        };
+    }
+
+    /**
+     * Index the vertices by ID, once the arrays are in place
+     */
+    void indexVertices()
+    {
+        _vertexById.reserve(_rows.size());
+        for (vertex_type v = 0; v < _rows.size(); ++v)
+            _vertexById.insert(id(v), v, keyOf());
+    }
+
+public:
+    csr_graph() = default;
+
+    // The arrays are referred to by span, which a copy would have to redirect
+    csr_graph(const csr_graph &) = delete;
+
+    csr_graph &operator=(const csr_graph &) = delete;
+
+    csr_graph(csr_graph &&) = default;
+
+    csr_graph &operator=(csr_graph &&) = default;
+
+    /**
+     * Build the graph from a list of undirected edges
+     * @param objects The objects, which the edges refer to by row
+     * @param edges The edges, in the order they would be inserted
+     */
+    csr_graph(const ObjectTable &objects, const std::vector<graph::edge> &edges) : _objects(&objects)
+    {
+        constexpr auto noVertex = std::numeric_limits<vertex_type>::max();
+
+        // Number the rows that have edges in the order of their IDs, merging equal IDs
+        std::vector<vertex_type> vertexOfRow(objects.size(), noVertex);
+        std::vector<std::uint32_t> rows;
+
+        for (const auto &e: edges)
+            for (auto row: {e.from, e.to})
+                if (vertexOfRow[row] == noVertex)
+                {
+                    vertexOfRow[row] = 0;
+                    rows.push_back(row);
+                }
+
+        std::sort(rows.begin(), rows.end(), [&](std::uint32_t a, std::uint32_t b)
+        {
+            auto idA = objects[a].objectId(), idB = objects[b].objectId();
+            return idA != idB ? idA < idB : a < b;
+        });
+
+        auto &vertexRows = _rowStorage;
+        for (auto row: rows)
+        {
+            if (vertexRows.empty() || objects[vertexRows.back()].objectId() != objects[row].objectId())
+                vertexRows.push_back(row);
+            vertexOfRow[row] = (vertex_type) vertexRows.size() - 1;
+        }
+
+        // Counting sort both directions of every edge by their source vertex
+        auto &offsets = _offsetStorage;
+        offsets.assign(vertexRows.size() + 1, 0);
+        for (const auto &e: edges)
+        {
+            ++offsets[vertexOfRow[e.from] + 1];
+            ++offsets[vertexOfRow[e.to] + 1];
+        }
+        for (std::size_t v = 0; v < vertexRows.size(); ++v)
+            offsets[v + 1] += offsets[v];
+
+        auto &neighbors = _neighborStorage;
+        neighbors.resize(offsets.back());
+        auto next = offsets;
+        for (const auto &e: edges)
+        {
+            auto from = vertexOfRow[e.from], to = vertexOfRow[e.to];
+            neighbors[next[from]++] = {to, e.weight};
+            neighbors[next[to]++] = {from, e.weight};
+        }
+
+        // Sort each vertex's neighbors, keeping the last edge to each, and close the gaps
+        std::uint64_t size = 0;
+        for (std::size_t v = 0; v < vertexRows.size(); ++v)
+        {
+            auto begin = neighbors.begin() + (std::ptrdiff_t) offsets[v];
+            auto end = neighbors.begin() + (std::ptrdiff_t) offsets[v + 1];
+
+            std::stable_sort(begin, end, [](const neighbor &a, const neighbor &b)
+            {
+                return a.vertex < b.vertex;
+            });
+
+            offsets[v] = size;
+            for (auto it = begin; it != end; ++it)
+            {
+                if (it + 1 != end && (it + 1)->vertex == it->vertex)
+                    continue;
+                neighbors[size++] = *it;
+            }
+        }
+
+        offsets.back() = size;
+        neighbors.resize(size);
+        neighbors.shrink_to_fit();
+
+        _rows = vertexRows;
+        _offsets = offsets;
+        _neighbors = neighbors;
+        indexVertices();
+    }
+
+    [[nodiscard]] std::size_t vertexCount() const
+    {
+        return _rows.size();
+    }
+
+    /**
+     * Gets the number of directed edges, i.e. twice the number of related pairs
+     */
+    [[nodiscard]] std::size_t edgeCount() const
+    {
+        return _neighbors.size();
+    }
+
+    /**
+     * Gets the vertex with the given ID
+     * @param id The requested vertex ID
+     * @return Optionally, the vertex if it is in the graph
+     */
+    std::optional<vertex_type> find(const std::string &id) const
+    {
+        return _vertexById.find(id, keyOf());
+    }
+
+    std::string_view id(vertex_type v) const
+    {
+        return (*_objects)[_rows[v]].objectId();
+    }
+
+    /**
+     * Calls fn(neighbor, weight) for every neighbor of a vertex, in ascending order of ID
+     */
+    template<typename F>
+    void forEachNeighbor(vertex_type v, F &&fn) const
+    {
+        for (auto i = _offsets[v]; i < _offsets[v + 1]; ++i)
+            fn(_neighbors[i].vertex, _neighbors[i].weight);
+    }
+
+    /**
+     * Copies the object of a vertex out of the table
+     */
+    MuseumObject object(vertex_type v) const
+    {
+        return (*_objects)[_rows[v]].toObject();
+    }
+
+    /**
+     * Generates a minimum spanning tree using the specified starting node, spanning
+     * only the vertices that can be reached from it
+     * @param startId The ID of the starting node
+     * @return The minimum spanning tree graph of this graph
+     */
+    graph mst(const std::string &startId) const
+    {
+        graph minTree;
+
+        graph_algorithms::mst(*this, startId, [&](vertex_type parent, vertex_type v, float cost)
+        {
+            minTree.addEdge(object(parent), object(v), cost);
+        });
+
+        return minTree;
+    }
+
+    /**
+     * Finds the shortest path between two vertices
+     * @param startId The ID of the source vertex
+     * @param endId The ID of the destination vertex
+     * @return A vector of vertices representing the path between Start and End
+     */
+    std::vector<MuseumObject> dijkstra(const std::string &startId, const std::string &endId) const
+    {
+        std::vector<MuseumObject> path;
+
+        for (auto v: graph_algorithms::dijkstra(*this, startId, endId))
+            path.push_back(object(v));
+
+        return path;
+    }
+};
+
+#endif //THEMET_CSR_GRAPH_H
@@ -33,6 +33,8 @@
 // 12/9/21
 // * completely remove threaded IO
 // * support line breaks in escaped strings
+// * read regular files and in-memory strings in place, memory-mapping files where available
+// * scan for separators, quotes and line breaks 16 to 32 bytes at a time where SSE2/AVX2 are available
 
 #ifndef THEMET_CSV_H
 #define THEMET_CSV_H
@@ -49,6 +51,26 @@
 #include <cerrno>
 #include <istream>
 #include <limits>
+#include <cstdint>
+
+#if !defined(CSV_IO_NO_MMAP) && (defined(__unix__) || defined(__APPLE__))
+#define CSV_IO_MMAP
+#endif
+
+#ifdef CSV_IO_MMAP
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#if !defined(CSV_IO_NO_SIMD) && defined(__GNUC__) && defined(__x86_64__)
+#define CSV_IO_SIMD
+#endif
+
+#ifdef CSV_IO_SIMD
+#include <immintrin.h>
+#endif
 
 namespace io
 {
@@ -236,6 +258,176 @@ namespace io
             long long remaining_byte_count;
         };
 
+#ifdef CSV_IO_MMAP
+
+        /**
+         * A read-only mapping of an entire regular file
+         */
+        class MappedFile
+        {
+        public:
+            MappedFile(const MappedFile &) = delete;
+
+            MappedFile &operator=(const MappedFile &) = delete;
+
+            /**
+             * Maps a file into memory
+             * @param file_name The file to map
+             * @param sequential True if the file will be walked front to back once, false if it will be read in no particular order
+             * @return The mapping, or nullptr if the file is not a non-empty regular file (pipes, stdin, ...) or can not be mapped
+             */
+            static std::unique_ptr<MappedFile> open(const char *file_name, bool sequential = true)
+            {
+                int fd = ::open(file_name, O_RDONLY);
+                if (fd == -1)
+                    return nullptr;
+
+                struct stat st{};
+                if (::fstat(fd, &st) != 0 || !S_ISREG(st.st_mode) || st.st_size == 0)
+                {
+                    ::close(fd);
+                    return nullptr;
+                }
+
+                void *data = ::mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+                ::close(fd);
+
+                if (data == MAP_FAILED)
+                    return nullptr;
+
+                ::madvise(data, st.st_size, sequential ? MADV_SEQUENTIAL : MADV_NORMAL);
+
+                return std::unique_ptr<MappedFile>(new MappedFile(static_cast<const char *>(data), st.st_size));
+            }
+
+            const char *data() const
+            {
+                return begin;
+            }
+
+            std::size_t size() const
+            {
+                return length;
+            }
+
+            ~MappedFile()
+            {
+                ::munmap(const_cast<char *>(begin), length);
+            }
+
+        private:
+            MappedFile(const char *begin, std::size_t length) : begin(begin), length(length)
+            {}
+
+            const char *begin;
+            std::size_t length;
+        };
+
+#endif
+
+        ////////////////////////////////////////////////////////////////////////////
+        //                               Scanning                                 //
+        ////////////////////////////////////////////////////////////////////////////
+
+        // The scanners look at 16 (SSE2) or 32 (AVX2) bytes at a time. SSE2 is part of
+        // x86-64, AVX2 is used where the CPU supports it for counting over long ranges.
+        // Columns are usually short, so finding their ends uses SSE2, which can be
+        // inlined, rather than dispatching to AVX2. Every scanner is bounded by the end
+        // of its range: it loads whole unaligned blocks only while they lie within the
+        // range, and finishes the rest a byte at a time, so it never reads past the end.
+        // Line breaks are found with memchr, which the C library already vectorizes.
+
+#ifdef CSV_IO_SIMD
+
+        inline bool has_avx2()
+        {
+            static const bool supported = __builtin_cpu_supports("avx2");
+            return supported;
+        }
+
+        inline const char *find_first_of_or_nul_sse2(const char *str, const char *end, char a, char b)
+        {
+            const __m128i va = _mm_set1_epi8(a), vb = _mm_set1_epi8(b), vz = _mm_setzero_si128();
+
+            for (; end - str >= 16; str += 16)
+            {
+                __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i *>(str));
+                __m128i hits = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(chunk, va), _mm_cmpeq_epi8(chunk, vb)), _mm_cmpeq_epi8(chunk, vz));
+                auto mask = (unsigned) _mm_movemask_epi8(hits);
+                if (mask != 0)
+                    return str + __builtin_ctz(mask);
+            }
+
+            while (str != end && *str != a && *str != b && *str != '\0')
+                ++str;
+            return str;
+        }
+
+        inline std::size_t count_byte_sse2(const char *begin, const char *end, char c)
+        {
+            const __m128i vc = _mm_set1_epi8(c);
+            std::size_t count = 0;
+
+            for (; end - begin >= 16; begin += 16)
+            {
+                __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i *>(begin));
+                count += __builtin_popcount((unsigned) _mm_movemask_epi8(_mm_cmpeq_epi8(chunk, vc)));
+            }
+
+            return count + std::count(begin, end, c);
+        }
+
+        __attribute__((target("avx2,popcnt"))) inline std::size_t count_byte_avx2(const char *begin, const char *end, char c)
+        {
+            const __m256i vc = _mm256_set1_epi8(c);
+            std::size_t count = 0;
+
+            for (; end - begin >= 32; begin += 32)
+            {
+                __m256i chunk = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(begin));
+                count += __builtin_popcount((unsigned) _mm256_movemask_epi8(_mm256_cmpeq_epi8(chunk, vc)));
+            }
+
+            return count + std::count(begin, end, c);
+        }
+
+#endif
+
+        /**
+         * Finds the first occurrence of either of two characters, or the terminator, in a NUL-terminated string
+         * @param str The string
+         * @param end The terminator of {str}, which nothing at or past is read
+         * @param a The first character to look for
+         * @param b The second character to look for, which may be the same as {a}
+         * @return The first {a}, {b} or NUL in {str}
+         */
+        inline const char *find_first_of_or_nul(const char *str, const char *end, char a, char b)
+        {
+#ifdef CSV_IO_SIMD
+            // Most columns of the dataset are empty, which a single comparison settles
+            if (str == end || *str == a || *str == b || *str == '\0')
+                return str;
+
+            return find_first_of_or_nul_sse2(str + 1, end, a, b);
+#else
+            while (str != end && *str != a && *str != b && *str != '\0')
+                ++str;
+            return str;
+#endif
+        }
+
+        /**
+         * Counts the occurrences of a character in a range
+         */
+        inline std::size_t count_byte(const char *begin, const char *end, char c)
+        {
+#ifdef CSV_IO_SIMD
+            return has_avx2() ? count_byte_avx2(begin, end, c) : count_byte_sse2(begin, end, c);
+#else
+            return std::count(begin, end, c);
+#endif
+        }
+
         class SynchronousReader
         {
         public:
@@ -276,6 +468,16 @@ namespace io
         int data_begin;
         int data_end;
 
+        // In-place mode: lines are handed out directly from [view_cursor, view_end)
+        // instead of being copied through the block buffer
+        bool in_place;
+#ifdef CSV_IO_MMAP
+        std::unique_ptr<detail::MappedFile> mapping;
+#endif
+        const char *view_cursor;
+        const char *view_end;
+        std::string line_buffer;
+
         char file_name[error::max_file_name_length + 1];
         unsigned file_line;
 
@@ -295,9 +497,35 @@ namespace io
             return std::unique_ptr<ByteSourceBase>(new detail::OwningStdIOByteSourceBase(file));
         }
 
+        void open(const char *file_name)
+        {
+#ifdef CSV_IO_MMAP
+            mapping = detail::MappedFile::open(file_name);
+            if (mapping)
+            {
+                init_in_place(mapping->data(), mapping->data() + mapping->size());
+                return;
+            }
+#endif
+            init(open_file(file_name));
+        }
+
+        void init_in_place(const char *begin, const char *end)
+        {
+            file_line = 0;
+            in_place = true;
+            view_cursor = begin;
+            view_end = end;
+
+            // Ignore UTF-8 BOM
+            if (view_end - view_cursor >= 3 && view_cursor[0] == '\xEF' && view_cursor[1] == '\xBB' && view_cursor[2] == '\xBF')
+                view_cursor += 3;
+        }
+
         void init(std::unique_ptr<ByteSourceBase> byte_source)
         {
             file_line = 0;
+            in_place = false;
 
             buffer = std::unique_ptr<char[]>(new char[3 * block_len]);
             data_begin = 0;
@@ -324,13 +552,13 @@ namespace io
         explicit LineReader(const char *file_name)
         {
             set_file_name(file_name);
-            init(open_file(file_name));
+            open(file_name);
         }
 
         explicit LineReader(const std::string &file_name)
         {
             set_file_name(file_name.c_str());
-            init(open_file(file_name.c_str()));
+            open(file_name.c_str());
         }
 
         LineReader(const char *file_name, std::unique_ptr<ByteSourceBase> byte_source)
@@ -348,13 +576,13 @@ namespace io
         LineReader(const char *file_name, const char *data_begin, const char *data_end)
         {
             set_file_name(file_name);
-            init(std::unique_ptr<ByteSourceBase>(new detail::NonOwningStringByteSource(data_begin, data_end - data_begin)));
+            init_in_place(data_begin, data_end);
         }
 
         LineReader(const std::string &file_name, const char *data_begin, const char *data_end)
         {
             set_file_name(file_name.c_str());
-            init(std::unique_ptr<ByteSourceBase>(new detail::NonOwningStringByteSource(data_begin, data_end - data_begin)));
+            init_in_place(data_begin, data_end);
         }
 
         LineReader(const char *file_name, FILE *file)
@@ -414,8 +642,69 @@ namespace io
             return file_line;
         }
 
+        bool is_in_place() const
+        {
+            return in_place;
+        }
+
+        /**
+         * Reads the next line without copying it
+         * @param line_begin Set to the first character of the line
+         * @param line_end Set to one past the last character of the line, excluding the line break
+         * @return False if there are no more lines
+         */
+        bool next_line(const char *&line_begin, const char *&line_end)
+        {
+            if (!in_place)
+            {
+                const char *line = next_line();
+                if (!line)
+                    return false;
+
+                line_begin = line;
+                line_end = line + std::strlen(line);
+                return true;
+            }
+
+            if (view_cursor == view_end)
+                return false;
+
+            ++file_line;
+
+            line_begin = view_cursor;
+            auto newline = static_cast<const char *>(std::memchr(view_cursor, '\n', view_end - view_cursor));
+            if (newline != nullptr)
+            {
+                line_end = newline;
+                view_cursor = newline + 1;
+            }
+            else
+            {
+                // some files are missing the newline at the end of the
+                // last line
+                line_end = view_end;
+                view_cursor = view_end;
+            }
+
+            // handle windows \r\n-line breaks
+            if (line_end != line_begin && *(line_end - 1) == '\r')
+                --line_end;
+
+            return true;
+        }
+
         char *next_line()
         {
+            if (in_place)
+            {
+                const char *line_begin, *line_end;
+                if (!next_line(line_begin, line_end))
+                    return nullptr;
+
+                line_buffer.assign(line_begin, line_end);
+                return line_buffer.data();
+            }
+
             if (data_begin == data_end)
                 return nullptr;
 
@@ -437,11 +726,10 @@ namespace io
                 }
             }
 
-            int line_end = data_begin;
-            while (line_end != data_end && buffer[line_end] != '\n')
-            {
-                ++line_end;
-            }
+            int line_end = data_end;
+            auto newline = static_cast<const char *>(std::memchr(buffer.get() + data_begin, '\n', data_end - data_begin));
+            if (newline != nullptr)
+                line_end = (int) (newline - buffer.get());
 
             if (line_end - data_begin + 1 > block_len)
             {
@@ -777,11 +1065,9 @@ namespace io
     template<char sep>
     struct no_quote_escape
     {
-        static const char *find_next_column_end(const char *col_begin)
+        static const char *find_next_column_end(const char *col_begin, const char *line_end)
         {
-            while (*col_begin != sep && *col_begin != '\0')
-                ++col_begin;
-            return col_begin;
+            return detail::find_first_of_or_nul(col_begin, line_end, sep, sep);
         }
 
         static void unescape(char *&, char *&)
@@ -793,26 +1079,22 @@ namespace io
     template<char sep, char quote>
     struct double_quote_escape
     {
-        static const char *find_next_column_end(const char *col_begin)
+        static const char *find_next_column_end(const char *col_begin, const char *line_end)
         {
-            while (*col_begin != sep && *col_begin != '\0')
+            while (true)
+            {
+                col_begin = detail::find_first_of_or_nul(col_begin, line_end, sep, quote);
                 if (*col_begin != quote)
-                    ++col_begin;
-                else
+                    return col_begin;
+
+                do
                 {
-                    do
-                    {
-                        ++col_begin;
-                        while (*col_begin != quote)
-                        {
-                            if (*col_begin == '\0')
-                                throw error::escaped_string_not_closed();
-                            ++col_begin;
-                        }
-                        ++col_begin;
-                    } while (*col_begin == quote);
-                }
-            return col_begin;
+                    col_begin = detail::find_first_of_or_nul(col_begin + 1, line_end, quote, quote);
+                    if (*col_begin == '\0')
+                        throw error::escaped_string_not_closed();
+                    ++col_begin;
+                } while (*col_begin == quote);
+            }
         }
 
         static void unescape(char *&col_begin, char *&col_end)
@@ -824,15 +1106,25 @@ namespace io
                     ++col_begin;
                     --col_end;
                     char *out = col_begin;
-                    for (char *in = col_begin; in != col_end; ++in)
+                    char *in = col_begin;
+
+                    // Copy the runs between quotes, dropping the first quote of each doubled pair
+                    while (true)
                     {
-                        if (*in == quote && (in + 1) != col_end && *(in + 1) == quote)
-                        {
+                        auto next = static_cast<char *>(std::memchr(in, quote, col_end - in));
+                        auto run_end = next != nullptr ? next + 1 : col_end;
+
+                        if (out != in)
+                            std::memmove(out, in, run_end - in);
+                        out += run_end - in;
+                        in = run_end;
+
+                        if (next == nullptr)
+                            break;
+                        if (in != col_end && *in == quote)
                             ++in;
-                        }
-                        *out = *in;
-                        ++out;
                     }
+
                     col_end = out;
                     *col_end = '\0';
                 }
@@ -889,14 +1181,14 @@ namespace io
     {
         template<class quote_policy>
         void chop_next_column(
-                char *&line, char *&col_begin, char *&col_end
+                char *&line, const char *line_end, char *&col_begin, char *&col_end
         )
         {
             assert(line != nullptr);
 
             col_begin = line;
             // the col_begin + (... - col_begin) removes the constness
-            col_end = col_begin + (quote_policy::find_next_column_end(col_begin) - col_begin);
+            col_end = col_begin + (quote_policy::find_next_column_end(col_begin, line_end) - col_begin);
 
             if (*col_end == '\0')
             {
@@ -916,12 +1208,15 @@ namespace io
                 const std::vector<int> &col_order
         )
         {
+            // Chopping only overwrites separators inside the line, so its end stays put
+            const char *line_end = line + std::strlen(line);
+
             for (int i: col_order)
             {
                 if (line == nullptr)
                     throw ::io::error::too_few_columns();
                 char *col_begin, *col_end;
-                chop_next_column<quote_policy>(line, col_begin, col_end);
+                chop_next_column<quote_policy>(line, line_end, col_begin, col_end);
 
                 if (i != -1)
                 {
@@ -945,12 +1240,14 @@ namespace io
         {
             col_order.clear();
 
+            const char *line_end = line + std::strlen(line);
+
             bool found[column_count];
             std::fill(found, found + column_count, false);
             while (line)
             {
                 char *col_begin, *col_end;
-                chop_next_column<quote_policy>(line, col_begin, col_end);
+                chop_next_column<quote_policy>(line, line_end, col_begin, col_end);
 
                 trim_policy::trim(col_begin, col_end);
                 quote_policy::unescape(col_begin, col_end);
@@ -1235,11 +1532,13 @@ namespace io
     private:
         LineReader in;
 
-        char *row[column_count];
         std::string column_names[column_count];
 
         std::vector<int> col_order;
 
+        // Reused for every row so that reading does not allocate once it has grown to the longest record
+        std::string record;
+
         template<class ...ColNames>
         void set_column_names(std::string s, ColNames...cols)
         {
@@ -1261,7 +1560,6 @@ namespace io
         template<class ...Args>
         explicit CSVReader(Args &&...args):in(std::forward<Args>(args)...)
         {
-            std::fill(row, row + column_count, nullptr);
             col_order.resize(column_count);
             for (unsigned i = 0; i < column_count; ++i)
                 col_order[i] = i;
@@ -1274,6 +1572,17 @@ namespace io
             return in.next_line();
         }
 
+        /**
+         * Adopts the column names and order of a reader that has already read its header,
+         * so that several readers can work on different byte ranges of the same file
+         * @param other The reader to copy the header from
+         */
+        void copy_header(const CSVReader &other)
+        {
+            std::copy(std::begin(other.column_names), std::end(other.column_names), std::begin(column_names));
+            col_order = other.col_order;
+        }
+
         template<class ...ColNames>
         void read_header(ignore_column ignore_policy, ColNames...cols)
         {
@@ -1309,7 +1618,6 @@ namespace io
             static_assert(sizeof...(ColNames) <= column_count,
                           "too many column names specified");
             set_column_names(std::forward<ColNames>(cols)...);
-            std::fill(row, row + column_count, nullptr);
             col_order.resize(column_count);
             for (unsigned i = 0; i < column_count; ++i)
                 col_order[i] = i;
@@ -1349,11 +1657,11 @@ namespace io
         }
 
     private:
-        void parse_helper(std::size_t)
+        void parse_helper(char **, std::size_t) const
         {}
 
         template<class T, class ...ColType>
-        void parse_helper(std::size_t r, T &t, ColType &...cols)
+        void parse_helper(char **row, std::size_t r, T &t, ColType &...cols) const
         {
             if (row[r])
             {
@@ -1373,59 +1681,46 @@ namespace io
                     throw;
                 }
             }
-            parse_helper(r + 1, cols...);
+            parse_helper(row, r + 1, cols...);
         }
 
-        bool containsUnbalancedQuotes(const char *str) const
+        static std::size_t countQuotes(const char *begin, const char *end)
         {
-            int n = 0;
-            for (int i = 0, length = (int) strlen(str); i < length; ++i)
-                if (str[i] == '"')
-                    n++;
-
-            return n % 2 != 0;
+            return detail::count_byte(begin, end, '"');
         }
 
     public:
-        template<class ...ColType>
-        bool read_row(ColType &...cols)
+        /**
+         * Reads the text of the next record without splitting it into columns
+         * @param record Set to the record, including any line breaks inside of escaped strings
+         * @return False if there are no more records
+         */
+        bool read_record(std::string &record)
         {
-            static_assert(sizeof...(ColType) >= column_count,
-                          "not enough columns specified");
-            static_assert(sizeof...(ColType) <= column_count,
-                          "too many columns specified");
             try
             {
                 try
                 {
-                    char *line;
+                    const char *line_begin, *line_end;
                     do
                     {
-                        line = in.next_line();
-                        if (!line)
+                        if (!in.next_line(line_begin, line_end))
                             return false;
-                    } while (comment_policy::is_comment(line));
+                        record.assign(line_begin, line_end);
+                    } while (comment_policy::is_comment(record.c_str()));
 
                     /// Begin line break support
-                    std::string buffer(line);
+                    auto quotes = countQuotes(line_begin, line_end);
 
-                    if (containsUnbalancedQuotes(line))
+                    while (quotes % 2 != 0)
                     {
-                        do
-                        {
-                            line = in.next_line();
-                            if (!line)
-                                return false;
-                            buffer.append("\n");
-                            buffer.append(line);
-                        } while (containsUnbalancedQuotes(buffer.c_str()));
+                        if (!in.next_line(line_begin, line_end))
+                            return false;
+                        record.push_back('\n');
+                        record.append(line_begin, line_end);
+                        quotes += countQuotes(line_begin, line_end);
                     }
                     /// End line break support
-
-                    detail::parse_line<trim_policy, quote_policy>
-                            (buffer.data(), row, col_order);
-
-                    parse_helper(0, cols...);
                 } catch (error::with_file_name &err)
                 {
                     err.set_file_name(in.get_truncated_file_name());
@@ -1439,6 +1734,53 @@ namespace io
 
             return true;
         }
+
+        /**
+         * Splits a record returned by read_record() into its columns and parses them.
+         * This doesn't change the state of the reader, so records can be parsed on
+         * other threads while this one keeps reading
+         * @param record The record, which is modified in place
+         */
+        template<class ...ColType>
+        void parse_record(char *record, ColType &...cols) const
+        {
+            static_assert(sizeof...(ColType) >= column_count,
+                          "not enough columns specified");
+            static_assert(sizeof...(ColType) <= column_count,
+                          "too many columns specified");
+            try
+            {
+                char *row[column_count];
+                std::fill(row, row + column_count, nullptr);
+
+                detail::parse_line<trim_policy, quote_policy>
+                        (record, row, col_order);
+
+                parse_helper(row, 0, cols...);
+            } catch (error::with_file_name &err)
+            {
+                err.set_file_name(in.get_truncated_file_name());
+                throw;
+            }
+        }
+
+        template<class ...ColType>
+        bool read_row(ColType &...cols)
+        {
+            if (!read_record(record))
+                return false;
+
+            try
+            {
+                parse_record(record.data(), cols...);
+            } catch (error::with_file_line &err)
+            {
+                err.set_file_line(in.get_file_line());
+                throw;
+            }
+
+            return true;
+        }
     };
 }
 
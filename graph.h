@@ -1,9 +1,17 @@
+#include <algorithm>
+#include <cstdint>
 #include <optional>
 #include <map>
+#include <memory>
+#include <memory_resource>
+#include <ranges>
 #include <utility>
 #include <vector>
 #include <set>
-#include <queue>
+#include <string>
+#include <string_view>
+#include "FlatIdIndex.h"
+#include "graph_algorithms.h"
 #include "MuseumObject.h"
 
 //
@@ -15,32 +23,139 @@
 
 class graph
 {
-private:
-    std::map<std::string, MuseumObject> _verticesById;
-    std::map<MuseumObject, std::map<MuseumObject, float>> _adjacency;
+public:
+    typedef const MuseumObject *vertex_type;
 
     /**
-     * Vertices used while calculating the shortest path
+     * Orders vertices by ID, whether given as objects or as the graph's vertices
      */
-    struct graph_path_vertex
+    struct by_id
     {
-        MuseumObject next;
-        float cost;
-        std::vector<MuseumObject> path;
+        typedef void is_transparent;
 
-        bool operator<(const graph_path_vertex &rhs) const
+        static const std::string &id(const MuseumObject &o)
         {
-            return cost > rhs.cost;
+            return o.objectId;
         }
 
-        graph_path_vertex(MuseumObject next, float cost) : next(std::move(next)), cost(cost), path()
-        {}
+        static const std::string &id(vertex_type v)
+        {
+            return v->objectId;
+        }
 
-        graph_path_vertex(MuseumObject next, float cost, std::vector<MuseumObject> path) : next(std::move(next)), cost(cost), path(std::move(path))
-        {}
+        template<typename A, typename B>
+        bool operator()(const A &a, const B &b) const
+        {
+            return id(a) < id(b);
+        }
     };
 
+    // The neighbors of a vertex point at their own entries in the adjacency list
+    typedef std::pmr::map<vertex_type, float, by_id> neighbor_map;
+    typedef std::pmr::map<MuseumObject, neighbor_map> adjacency_map;
+
+private:
+    /**
+     * The maps of a graph and the memory their nodes are allocated from. Nodes are
+     * carved out of large blocks, so building a graph rarely calls malloc and tearing it
+     * down frees a few blocks. The memory of removed edges is only returned then, too.
+     * Each vertex's object is stored once, in the adjacency list, so its strings are
+     * only copied once too
+     */
+    struct arena
+    {
+        std::pmr::monotonic_buffer_resource resource;
+        adjacency_map adjacency{&resource};
+    };
+
+    // On the heap, so the maps keep their memory resource when the graph is moved
+    std::unique_ptr<arena> _arena = std::make_unique<arena>();
+
+    // Every vertex by a dense index, and the index of every vertex by its ID
+    std::vector<vertex_type> _vertices;
+    FlatIdIndex _indexById;
+
+    auto keyOf() const
+    {
+        return [this](std::uint32_t index)
+        {
+            return std::string_view(_vertices[index]->objectId);
+        };
+    }
+
+    void index(const MuseumObject &vertex)
+    {
+        _vertices.push_back(&vertex);
+        _indexById.insert(vertex.objectId, (std::uint32_t) _vertices.size() - 1, keyOf());
+    }
+
+    void reindex()
+    {
+        _vertices.clear();
+        _indexById.clear();
+        _indexById.reserve(_arena->adjacency.size());
+
+        _vertices.reserve(_arena->adjacency.size());
+        for (const auto &pair: _arena->adjacency)
+            index(pair.first);
+    }
+
 public:
+    graph() = default;
+
+    graph(const graph &other)
+    {
+        *this = other;
+    }
+
+    graph(graph &&other)
+    {
+        swap(other);
+    }
+
+    graph &operator=(const graph &other)
+    {
+        if (this != &other)
+        {
+            _arena = std::make_unique<arena>();
+
+            for (const auto &pair: other._arena->adjacency)
+                _arena->adjacency.emplace_hint(_arena->adjacency.end(), pair.first, neighbor_map());
+
+            // The neighbors have to point at this graph's vertices
+            for (auto &pair: _arena->adjacency)
+                for (const auto &neighbor: other._arena->adjacency.find(pair.first)->second)
+                    pair.second.emplace_hint(pair.second.end(), &_arena->adjacency.find(*neighbor.first)->first, neighbor.second);
+
+            reindex();
+        }
+
+        return *this;
+    }
+
+    graph &operator=(graph &&other) noexcept
+    {
+        swap(other);
+        return *this;
+    }
+
+    void swap(graph &other) noexcept
+    {
+        std::swap(_arena, other._arena);
+        std::swap(_vertices, other._vertices);
+        std::swap(_indexById, other._indexById);
+    }
+
+    /**
+     * An edge between two vertices, given by their index in a list of vertices
+     */
+    struct edge
+    {
+        std::uint32_t from;
+        std::uint32_t to;
+        float weight;
+    };
+
     /**
      * Insert an edge into the graph
      * @param a Source vertex
@@ -49,11 +164,87 @@ public:
      */
     void addEdge(const MuseumObject &a, const MuseumObject &b, float weight)
     {
-        _adjacency[a][b] = weight;
-        _adjacency[b][a] = weight;
+        auto [from, addedFrom] = _arena->adjacency.try_emplace(a);
+        auto [to, addedTo] = _arena->adjacency.try_emplace(b);
+
+        from->second[&to->first] = weight;
+        to->second[&from->first] = weight;
+
+        if (addedFrom)
+            index(from->first);
+        if (addedTo)
+            index(to->first);
+    }
+
+    /**
+     * Insert many edges into the graph at once. This has the same result as calling
+     * addEdge for every edge in order, but builds an empty graph's maps from sorted
+     * runs instead of searching them for every edge
+     * @param vertices The vertices the edges refer to; vertices with the same ID are the same vertex
+     * @param edges The edges, by index into {vertices}
+     */
+    void addEdges(const std::vector<MuseumObject> &vertices, const std::vector<edge> &edges)
+    {
+        if (!_arena->adjacency.empty())
+        {
+            for (const auto &e: edges)
+                addEdge(vertices[e.from], vertices[e.to], e.weight);
+            return;
+        }
+
+        // Rank the vertices in the order of the maps, i.e. by ID
+        std::vector<std::uint32_t> byId(vertices.size());
+        for (std::uint32_t i = 0; i < byId.size(); ++i)
+            byId[i] = i;
+
+        std::stable_sort(byId.begin(), byId.end(), [&](std::uint32_t a, std::uint32_t b)
+        {
+            return vertices[a] < vertices[b];
+        });
+
+        std::vector<std::uint32_t> rank(vertices.size()), ranked;
+        for (auto i: byId)
+        {
+            if (ranked.empty() || vertices[ranked.back()] < vertices[i])
+                ranked.push_back(i);
+            rank[i] = (std::uint32_t) ranked.size() - 1;
+        }
+
+        // Both directions of every edge, in the order addEdge would write them
+        std::vector<std::pair<std::uint64_t, float>> directed;
+        directed.reserve(edges.size() * 2);
+        for (const auto &e: edges)
+        {
+            directed.emplace_back((std::uint64_t) rank[e.from] << 32 | rank[e.to], e.weight);
+            directed.emplace_back((std::uint64_t) rank[e.to] << 32 | rank[e.from], e.weight);
+        }
 
-        _verticesById[a.objectId] = a;
-        _verticesById[b.objectId] = b;
+        std::stable_sort(directed.begin(), directed.end(), [](const auto &a, const auto &b)
+        {
+            return a.first < b.first;
+        });
+
+        // Every vertex with an edge is the source of one, so the sources are all the vertices
+        std::vector<adjacency_map::iterator> entries(ranked.size(), _arena->adjacency.end());
+        for (const auto &pair: directed)
+        {
+            auto from = pair.first >> 32;
+            if (entries[from] == _arena->adjacency.end())
+                entries[from] = _arena->adjacency.emplace_hint(_arena->adjacency.end(), vertices[ranked[from]], neighbor_map());
+        }
+
+        for (std::size_t i = 0; i < directed.size(); ++i)
+        {
+            // The last write to an edge wins
+            auto key = directed[i].first;
+            if (i + 1 < directed.size() && directed[i + 1].first == key)
+                continue;
+
+            auto &neighbors = entries[key >> 32]->second;
+            neighbors.emplace_hint(neighbors.end(), &entries[key & 0xFFFFFFFF]->first, directed[i].second);
+        }
+
+        reindex();
     }
 
     /**
@@ -62,135 +253,157 @@ public:
      * @param b Destination vertex
      * @return Optionally, the edge weight if the edge exists
      */
-    std::optional<float> getWeight(const MuseumObject &a, const MuseumObject &b)
+    std::optional<float> getWeight(const MuseumObject &a, const MuseumObject &b) const
     {
-        if (!_adjacency.count(a) || !_adjacency[a].count(b))
+        const auto &adjacent = neighbors(a);
+
+        auto it = adjacent.find(b);
+        if (it == adjacent.end())
             return {};
 
-        return _adjacency[a][b];
+        return it->second;
+    }
+
+    /**
+     * Gets all neighbors of a vertex, without copying them
+     * @param a Source vertex
+     * @return A map of all neighbor vertices and the weights to them, which is empty if
+     * the vertex isn't in the graph. It is valid until the graph is changed
+     */
+    const neighbor_map &neighbors(const MuseumObject &a) const
+    {
+        static const neighbor_map none;
+
+        auto it = _arena->adjacency.find(a);
+        return it == _arena->adjacency.end() ? none : it->second;
     }
 
     /**
-     * Gets all neighbors of a vertex
+     * Gets a copy of all neighbors of a vertex
      * @param a Source vertex
-     * @return A map of all neighbor vertices and the weights to them
+     * @return A map of all neighbor vertices and the weights to them. The neighbors still
+     * point at this graph's vertices
      */
-    std::map<MuseumObject, float> getNeighbors(const MuseumObject &a)
+    neighbor_map getNeighbors(const MuseumObject &a) const
     {
-        return _adjacency[a];
+        return neighbors(a);
     }
 
     /**
      * Gets the vertex with the given ID
      * @param id The requested vertex ID
-     * @return The vertex with the given ID
+     * @return The vertex with the given ID, or an empty object if there is none
      */
-    MuseumObject getById(const std::string &id)
+    MuseumObject getById(const std::string &id) const
     {
-        return _verticesById[id];
+        auto vertex = find(id);
+        return vertex ? **vertex : MuseumObject();
     }
 
     /**
-     * Gets the entire adjacency list
-     * @return The entire adjacency list
+     * Gets all vertices, in ascending order of ID, without copying them
+     * @return A view of the vertices, which is valid until the graph is changed
      */
-    std::map<MuseumObject, std::map<MuseumObject, float>> getAdjacency()
+    auto vertices() const
     {
-        return _adjacency;
+        return std::views::keys(_arena->adjacency);
     }
 
     /**
-     * Generates a minimum spanning tree using the specified starting node
-     * @param startId The ID of the starting node
-     * @return The minimum spanning tree graph of this graph
+     * Gets the entire adjacency list, without copying it
+     * @return The adjacency list, which is valid until the graph is changed
      */
-    graph mst(const std::string &startId)
+    const adjacency_map &adjacency() const
     {
-        auto start = getById(startId);
+        return _arena->adjacency;
+    }
 
-        if (start.isInvalid())
+    /**
+     * Gets a copy of the entire adjacency list
+     * @return The entire adjacency list. The neighbors still point at this graph's vertices
+     */
+    adjacency_map getAdjacency() const
+    {
+        return _arena->adjacency;
+    }
+
+    /*
+     * The interface used by graph_algorithms
+     */
+
+    /**
+     * Gets the vertex with the given ID
+     * @param id The requested vertex ID
+     * @return Optionally, the vertex if it is in the graph
+     */
+    std::optional<vertex_type> find(const std::string &id) const
+    {
+        auto index = _indexById.find(id, keyOf());
+        if (!index)
             return {};
 
-        std::set<MuseumObject> n, b;
-        graph minTree;
+        return _vertices[*index];
+    }
 
-        for (auto const &pair: _adjacency)
-            n.insert(pair.first);
+    std::string_view id(vertex_type v) const
+    {
+        return v->objectId;
+    }
 
-        b.insert(start);
+    /**
+     * Calls fn(neighbor, weight) for every neighbor of a vertex, in ascending order of ID
+     */
+    template<typename F>
+    void forEachNeighbor(vertex_type v, F &&fn) const
+    {
+        for (const auto &pair: _arena->adjacency.find(*v)->second)
+            fn(pair.first, pair.second);
+    }
 
-        while (b != n)
+    /**
+     * Generates a minimum spanning tree using the specified starting node, spanning
+     * only the vertices that can be reached from it. Hub vertices are left out, and
+     * the objects around a hub are linked directly with the cost of the path through it
+     * @param startId The ID of the starting node
+     * @return The minimum spanning tree graph of this graph
+     */
+    graph mst(const std::string &startId) const
+    {
+        graph minTree;
+
+        // The object each hub in the tree was reached from, and the cost of reaching it
+        std::map<vertex_type, std::pair<vertex_type, float>> hubParents;
+
+        graph_algorithms::mst(*this, startId, [&](vertex_type parent, vertex_type v, float cost)
         {
-            float minCost = std::numeric_limits<float>::max();
-            MuseumObject foundVertex, foundParent;
-
-            std::vector<MuseumObject> diff;
-            std::set_difference(n.begin(), n.end(), b.begin(), b.end(), std::inserter(diff, diff.begin()));
-
-            for (const auto &node: b)
-            {
-                for (const auto &neighbor: getNeighbors(node))
-                {
-                    if (std::find(diff.begin(), diff.end(), neighbor.first) != diff.end())
-                    {
-                        if (minCost > neighbor.second)
-                        {
-                            minCost = neighbor.second;
-                            foundParent = node;
-                            foundVertex = neighbor.first;
-                        }
-                    }
-                }
-            }
-
-            b.insert(foundVertex);
-            minTree.addEdge(foundParent, foundVertex, minCost);
-        }
+            // Hubs are left out of the tree: every object reached through one is linked
+            // to the object the hub was reached from instead
+            if (v->isHub())
+                hubParents[v] = {parent, cost};
+            else if (parent->isHub())
+                minTree.addEdge(*hubParents[parent].first, *v, hubParents[parent].second + cost);
+            else
+                minTree.addEdge(*parent, *v, cost);
+        });
 
         return minTree;
     }
 
     /**
-     * Finds the shortest path between two vertices
+     * Finds the shortest path between two vertices. Hub vertices on the path are left out
      * @param startId The ID of the source vertex
      * @param endId The ID of the destination vertex
      * @return A vector of vertices representing the path between Start and End
      */
-    std::vector<MuseumObject> dijkstra(const std::string &startId, const std::string &endId)
+    std::vector<MuseumObject> dijkstra(const std::string &startId, const std::string &endId) const
     {
-        auto start = getById(startId);
-        auto end = getById(endId);
-
-        if (start.isInvalid() || end.isInvalid())
-            return {};
-
-        std::set<MuseumObject> searched;
-        std::priority_queue<graph_path_vertex> boundary;
-
-        boundary.push(graph_path_vertex(start, 0));
-
-        while (!boundary.empty())
-        {
-            auto top = boundary.top();
-            boundary.pop();
-
-            if (top.next == end)
-            {
-                top.path.push_back(end);
-                return top.path;
-            }
-
-            if (searched.find(top.next) != searched.end())
-                continue;
-
-            searched.insert(top.next);
-            top.path.push_back(top.next);
+        std::vector<MuseumObject> path;
 
-            for (auto const &pair: getNeighbors(top.next))
-                boundary.push(graph_path_vertex(pair.first, pair.second + top.cost, top.path));
-        }
+        for (auto v: graph_algorithms::dijkstra(*this, startId, endId))
+            if (!v->isHub())
+                path.push_back(*v);
 
-        return {};
+        return path;
     }
 };
 
@@ -0,0 +1,159 @@
+#include <cstddef>
+#include <functional>
+#include <limits>
+#include <optional>
+#include <queue>
+#include <string>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+#ifndef THEMET_GRAPH_ALGORITHMS_H
+#define THEMET_GRAPH_ALGORITHMS_H
+
+/*
+ * Graph algorithms that run on any graph providing:
+ *
+ *  - vertex_type, a cheap, hashable handle to a vertex
+ *  - std::optional<vertex_type> find(const std::string &id) const, the vertex with an object ID
+ *  - std::string_view id(vertex_type) const, the object ID of a vertex
+ *  - void forEachNeighbor(vertex_type, F fn) const, calling fn(neighbor, weight) for
+ *    every neighbor in ascending order of object ID
+ *
+ * so they work the same on graphs that store their edges and on graphs that
+ * generate them when asked.
+ */
+namespace graph_algorithms
+{
+    /**
+     * Finds the shortest path between two vertices
+     * @param g The graph
+     * @param startId The ID of the source vertex
+     * @param endId The ID of the destination vertex
+     * @return The vertices of the path between Start and End, or nothing if there is no path
+     */
+    template<typename Graph>
+    std::vector<typename Graph::vertex_type> dijkstra(const Graph &g, const std::string &startId, const std::string &endId)
+    {
+        typedef typename Graph::vertex_type vertex;
+
+        auto start = g.find(startId);
+        auto end = g.find(endId);
+
+        if (!start || !end)
+            return {};
+
+        constexpr auto noParent = std::numeric_limits<std::size_t>::max();
+
+        // Each vertex on the boundary points at the searched vertex it was reached from
+        struct path_vertex
+        {
+            vertex next;
+            float cost;
+            std::size_t parent;
+
+            bool operator<(const path_vertex &rhs) const
+            {
+                return cost > rhs.cost;
+            }
+        };
+
+        std::vector<std::pair<vertex, std::size_t>> searchedPaths;
+        std::unordered_set<vertex> searched;
+        std::priority_queue<path_vertex> boundary;
+
+        boundary.push({*start, 0, noParent});
+
+        while (!boundary.empty())
+        {
+            auto top = boundary.top();
+            boundary.pop();
+
+            if (top.next == *end)
+            {
+                std::vector<vertex> path{*end};
+                for (auto i = top.parent; i != noParent; i = searchedPaths[i].second)
+                    path.push_back(searchedPaths[i].first);
+
+                return {path.rbegin(), path.rend()};
+            }
+
+            if (!searched.insert(top.next).second)
+                continue;
+
+            auto index = searchedPaths.size();
+            searchedPaths.emplace_back(top.next, top.parent);
+
+            g.forEachNeighbor(top.next, [&](vertex neighbor, float weight)
+            {
+                boundary.push({neighbor, weight + top.cost, index});
+            });
+        }
+
+        return {};
+    }
+
+    /**
+     * Generates a minimum spanning tree using the specified starting vertex, spanning
+     * only the vertices that can be reached from it
+     *
+     * Of the cheapest edges leaving the tree, the one whose inner vertex and then outer
+     * vertex has the lowest object ID is added first.
+     * @param g The graph
+     * @param startId The ID of the starting vertex
+     * @param addEdge Called with (inner vertex, outer vertex, weight) for every edge of the tree, in the order they are added
+     */
+    template<typename Graph, typename F>
+    void mst(const Graph &g, const std::string &startId, F &&addEdge)
+    {
+        typedef typename Graph::vertex_type vertex;
+
+        auto start = g.find(startId);
+        if (!start)
+            return;
+
+        struct candidate
+        {
+            float cost;
+            vertex parent;
+            vertex next;
+        };
+
+        auto isWorse = [&](const candidate &a, const candidate &b)
+        {
+            if (a.cost != b.cost)
+                return a.cost > b.cost;
+            if (g.id(a.parent) != g.id(b.parent))
+                return g.id(a.parent) > g.id(b.parent);
+            return g.id(a.next) > g.id(b.next);
+        };
+
+        std::priority_queue<candidate, std::vector<candidate>, decltype(isWorse)> boundary(isWorse);
+        std::unordered_set<vertex> tree{*start};
+
+        auto expand = [&](vertex v)
+        {
+            g.forEachNeighbor(v, [&](vertex neighbor, float weight)
+            {
+                if (!tree.count(neighbor))
+                    boundary.push({weight, v, neighbor});
+            });
+        };
+
+        expand(*start);
+
+        while (!boundary.empty())
+        {
+            auto top = boundary.top();
+            boundary.pop();
+
+            if (!tree.insert(top.next).second)
+                continue;
+
+            addEdge(top.parent, top.next, top.cost);
+            expand(top.next);
+        }
+    }
+}
+
+#endif //THEMET_GRAPH_ALGORITHMS_H
@@ -0,0 +1,400 @@
+#include <algorithm>
+#include <cstdint>
+#include <limits>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <vector>
+#include "FlatIdIndex.h"
+#include "graph.h"
+#include "graph_algorithms.h"
+#include "MuseumObject.h"
+#include "ObjectTable.h"
+
+#ifndef THEMET_IMPLICIT_GRAPH_H
+#define THEMET_IMPLICIT_GRAPH_H
+
+/**
+ * The graph fillGraph would build from a table of objects, without storing any of its
+ * edges: the neighbors of a vertex are generated from an index whenever they're asked for
+ *
+ * Comparators with float keys score the distance between keys, so the neighbors of an
+ * object are found in a window around it in the objects sorted by key. Comparators with
+ * integer keys (dictionary IDs) only relate equal keys, so the neighbors of an object
+ * are the other objects in its key's bucket.
+ *
+ * Vertices are the rows of the table, which must outlive the graph. Like in a graph,
+ * rows with the same object ID are one vertex: the first of the rows, with the neighbors
+ * of all of them.
+ * @tparam T The scoring function
+ */
+template<typename T>
+class implicit_graph
+{
+public:
+    typedef std::uint32_t vertex_type;
+
+private:
+    static constexpr bool isDistance = std::is_floating_point_v<typename T::key_type>;
+
+    const ObjectTable *_objects;
+    const std::vector<typename T::key_type> *_keys;
+    float _maxCost;
+
+    // The rows, sorted by key and then by object ID
+    std::vector<std::uint32_t> _order;
+
+    // The position of each row in _order
+    std::vector<std::uint32_t> _position;
+
+    // The rank of each row's object ID among all of them, so neighbors are put in order of ID without comparing strings
+    std::vector<std::uint32_t> _idRank;
+
+    // For integer keys, the start of each key's bucket in _order, followed by the end of the last one
+    std::vector<std::uint32_t> _bucketStart;
+
+    FlatIdIndex _rowsById;
+
+    static constexpr std::uint32_t noRow = std::numeric_limits<std::uint32_t>::max();
+
+    // Only if several rows share an object ID: the vertex of each row, and the next row with its ID
+    std::vector<vertex_type> _vertexOfRow;
+    std::vector<std::uint32_t> _nextRowWithId;
+
+    /**
+     * A neighbor found by forEachNeighbor before it is put in order. For a vertex whose ID
+     * several rows share, low and high are the keys of the pair of rows relating them
+     */
+    struct candidate
+    {
+        vertex_type vertex;
+        float weight;
+        typename T::key_type low, high;
+    };
+
+    // Reused by forEachNeighbor, which searches call for every vertex they visit, so that it
+    // doesn't allocate every time. This makes forEachNeighbor unsafe to call from several threads
+    mutable std::vector<candidate> _scratch;
+
+    /**
+     * Takes the scratch buffer for a call of forEachNeighbor. A call made from within another
+     * one's fn finds it taken and gets a buffer of its own
+     */
+    std::vector<candidate> takeScratch() const
+    {
+        auto scratch = std::move(_scratch);
+        _scratch = {};
+        scratch.clear();
+        return scratch;
+    }
+
+    auto keyOf() const
+    {
+        return [this](vertex_type v)
+        {
+            return id(v);
+        };
+    }
+
+    bool rowHasNeighbors(std::uint32_t row) const
+    {
+        auto comparator = T();
+        const auto &keys = *_keys;
+
+        if constexpr (isDistance)
+        {
+            // The closest keys are right next to the row's
+            auto position = _position[row];
+            return (position > 0 && comparator(keys[row], keys[_order[position - 1]]) <= _maxCost)
+                   || (position + 1 < _order.size() && comparator(keys[row], keys[_order[position + 1]]) <= _maxCost);
+        }
+        else
+        {
+            return _bucketStart[keys[row] + 1] - _bucketStart[keys[row]] > 1 && comparator(keys[row], keys[row]) <= _maxCost;
+        }
+    }
+
+    bool hasNeighbors(vertex_type v) const
+    {
+        if (_nextRowWithId.empty())
+            return rowHasNeighbors(v);
+
+        for (auto row = v; row != noRow; row = _nextRowWithId[row])
+            if (rowHasNeighbors(row))
+                return true;
+
+        return false;
+    }
+
+    /**
+     * Calls fn(row, weight) for every row related to a row, in no particular order
+     */
+    template<typename F>
+    void forEachRowNeighbor(std::uint32_t row, F &&fn) const
+    {
+        auto comparator = T();
+        const auto &keys = *_keys;
+
+        if constexpr (isDistance)
+        {
+            // Walk out from the row in both directions until the keys are too far away
+            auto position = _position[row];
+
+            for (auto i = position; i-- > 0;)
+            {
+                auto cost = comparator(keys[row], keys[_order[i]]);
+                if (cost > _maxCost)
+                    break;
+                fn(_order[i], cost);
+            }
+
+            for (auto i = position + 1; i < _order.size(); ++i)
+            {
+                auto cost = comparator(keys[row], keys[_order[i]]);
+                if (cost > _maxCost)
+                    break;
+                fn(_order[i], cost);
+            }
+        }
+        else
+        {
+            // Every pair in a bucket has the same key, so they all score the same
+            auto cost = comparator(keys[row], keys[row]);
+            if (cost > _maxCost)
+                return;
+
+            // The bucket is sorted by ID
+            for (auto i = _bucketStart[keys[row]]; i < _bucketStart[keys[row] + 1]; ++i)
+                if (_order[i] != row)
+                    fn(_order[i], cost);
+        }
+    }
+
+    /**
+     * Calls fn(neighbor, weight) for every neighbor of a vertex whose ID more than one row shares
+     *
+     * A pair of vertices may be related by several pairs of their rows. fillGraph inserts the
+     * pairs in order of their keys, lower key first, and the last one inserted wins, so that is
+     * the one whose weight is kept. Pairs with the same keys score the same.
+     */
+    template<typename F>
+    void forEachMergedNeighbor(vertex_type v, F &&fn) const
+    {
+        const auto &keys = *_keys;
+
+        auto neighbors = takeScratch();
+        for (auto row = v; row != noRow; row = _nextRowWithId[row])
+            forEachRowNeighbor(row, [&](std::uint32_t neighbor, float weight)
+            {
+                auto a = keys[row], b = keys[neighbor];
+                neighbors.push_back({_vertexOfRow[neighbor], weight, std::min(a, b), std::max(a, b)});
+            });
+
+        std::sort(neighbors.begin(), neighbors.end(), [&](const candidate &a, const candidate &b)
+        {
+            if (a.vertex != b.vertex)
+                return _idRank[a.vertex] < _idRank[b.vertex];
+            if (a.low != b.low)
+                return a.low < b.low;
+            return a.high < b.high;
+        });
+
+        for (std::size_t i = 0; i < neighbors.size(); ++i)
+            if (i + 1 == neighbors.size() || neighbors[i + 1].vertex != neighbors[i].vertex)
+                fn(neighbors[i].vertex, neighbors[i].weight);
+
+        _scratch = std::move(neighbors);
+    }
+
+public:
+    /**
+     * Index a table of objects
+     * @param objects The objects
+     * @param maxCost The maximum cost allowed between vertices to still generate a connection
+     */
+    implicit_graph(const ObjectTable &objects, float maxCost) : _objects(&objects), _keys(&T::keys(objects)), _maxCost(maxCost)
+    {
+        const auto &keys = *_keys;
+
+        _order.resize(keys.size());
+        for (std::uint32_t row = 0; row < keys.size(); ++row)
+            _order[row] = row;
+
+        std::sort(_order.begin(), _order.end(), [&](std::uint32_t a, std::uint32_t b)
+        {
+            if (keys[a] != keys[b])
+                return keys[a] < keys[b];
+            return objects[a].objectId() < objects[b].objectId();
+        });
+
+        _position.resize(keys.size());
+        for (std::uint32_t i = 0; i < _order.size(); ++i)
+            _position[_order[i]] = i;
+
+        std::vector<std::uint32_t> byId(_order);
+        std::sort(byId.begin(), byId.end(), [&](std::uint32_t a, std::uint32_t b)
+        {
+            return objects[a].objectId() < objects[b].objectId();
+        });
+
+        _idRank.resize(keys.size());
+        for (std::uint32_t i = 0; i < byId.size(); ++i)
+            _idRank[byId[i]] = i;
+
+        if constexpr (!isDistance)
+        {
+            auto keyCount = keys.empty() ? 0 : (std::size_t) *std::max_element(keys.begin(), keys.end()) + 1;
+
+            _bucketStart.assign(keyCount + 1, 0);
+            for (auto key: keys)
+                ++_bucketStart[key + 1];
+            for (std::size_t key = 0; key < keyCount; ++key)
+                _bucketStart[key + 1] += _bucketStart[key];
+        }
+
+        // The first row with an ID is its vertex, as the others would be merged into it in a graph
+        _rowsById.reserve(keys.size());
+        bool duplicates = false;
+        for (std::uint32_t row = 0; row < keys.size(); ++row)
+            duplicates |= !_rowsById.insert(objects[row].objectId(), row, keyOf());
+
+        if (!duplicates)
+            return;
+
+        // Chain the rows of each vertex together, in ascending order
+        _vertexOfRow.resize(keys.size());
+        _nextRowWithId.assign(keys.size(), noRow);
+        std::vector<std::uint32_t> lastRow(keys.size(), noRow);
+
+        for (std::uint32_t row = 0; row < keys.size(); ++row)
+        {
+            auto vertex = *_rowsById.find(objects[row].objectId(), keyOf());
+            _vertexOfRow[row] = vertex;
+
+            if (lastRow[vertex] != noRow)
+                _nextRowWithId[lastRow[vertex]] = row;
+            lastRow[vertex] = row;
+        }
+    }
+
+    /**
+     * Gets the vertex with the given ID. Like in a graph built by fillGraph, objects
+     * without any edges aren't part of the graph
+     * @param id The requested vertex ID
+     * @return Optionally, the vertex if it is in the graph
+     */
+    std::optional<vertex_type> find(const std::string &id) const
+    {
+        auto row = _rowsById.find(id, keyOf());
+        if (!row || !hasNeighbors(*row))
+            return {};
+
+        return row;
+    }
+
+    std::string_view id(vertex_type v) const
+    {
+        return (*_objects)[v].objectId();
+    }
+
+    /**
+     * Gets the row a csr_graph grouped from the same table keeps for a vertex: the first
+     * of its rows that has any neighbors
+     * @param v A vertex that find returned
+     * @return The row
+     */
+    std::uint32_t rowOf(vertex_type v) const
+    {
+        if (_nextRowWithId.empty())
+            return v;
+
+        auto row = v;
+        while (!rowHasNeighbors(row))
+            row = _nextRowWithId[row];
+
+        return row;
+    }
+
+    /**
+     * Calls fn(neighbor, weight) for every neighbor of a vertex, in ascending order of ID
+     */
+    template<typename F>
+    void forEachNeighbor(vertex_type v, F &&fn) const
+    {
+        if (!_nextRowWithId.empty())
+        {
+            forEachMergedNeighbor(v, fn);
+            return;
+        }
+
+        if constexpr (isDistance)
+        {
+            // The window around the row is in order of key, so put it in order of ID
+            auto neighbors = takeScratch();
+            forEachRowNeighbor(v, [&](std::uint32_t neighbor, float weight)
+            {
+                neighbors.push_back({neighbor, weight});
+            });
+
+            std::sort(neighbors.begin(), neighbors.end(), [&](const candidate &a, const candidate &b)
+            {
+                return _idRank[a.vertex] < _idRank[b.vertex];
+            });
+
+            for (const auto &neighbor: neighbors)
+                fn(neighbor.vertex, neighbor.weight);
+
+            _scratch = std::move(neighbors);
+        }
+        else
+        {
+            // The bucket is already sorted by ID
+            forEachRowNeighbor(v, fn);
+        }
+    }
+
+    /**
+     * Copies the object of a vertex out of the table
+     */
+    MuseumObject object(vertex_type v) const
+    {
+        return (*_objects)[v].toObject();
+    }
+
+    /**
+     * Generates a minimum spanning tree using the specified starting node, spanning
+     * only the vertices that can be reached from it
+     * @param startId The ID of the starting node
+     * @return The minimum spanning tree graph of this graph
+     */
+    graph mst(const std::string &startId) const
+    {
+        graph minTree;
+
+        graph_algorithms::mst(*this, startId, [&](vertex_type parent, vertex_type v, float cost)
+        {
+            minTree.addEdge(object(parent), object(v), cost);
+        });
+
+        return minTree;
+    }
+
+    /**
+     * Finds the shortest path between two vertices
+     * @param startId The ID of the source vertex
+     * @param endId The ID of the destination vertex
+     * @return A vector of vertices representing the path between Start and End
+     */
+    std::vector<MuseumObject> dijkstra(const std::string &startId, const std::string &endId) const
+    {
+        std::vector<MuseumObject> path;
+
+        for (auto v: graph_algorithms::dijkstra(*this, startId, endId))
+            path.push_back(object(v));
+
+        return path;
+    }
+};
+
+#endif //THEMET_IMPLICIT_GRAPH_H
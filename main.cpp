@@ -1,70 +1,21 @@
+#include <algorithm>
 #include <iostream>
-#include <optional>
-#include "csv.h"
+#include "csr_graph.h"
 #include "graph.h"
+#include "GraphEstimator.h"
+#include "GraphFile.h"
+#include "IncrementalGrouper.h"
+#include "IngestStats.h"
+#include "parallel.h"
 #include "MuseumObject.h"
+#include "MuseumObjectGrouper.h"
+#include "MuseumObjectLoader.h"
+#include "ObjectSnapshot.h"
+#include "ObjectTable.h"
+#include "ObjectUpdater.h"
 
 using namespace std;
 
-/**
- * Provides a standardized way to insert pairs of MuseumObjects
- * into the graph using the scoring function provided by T
- * @tparam T The scoring function
- */
-template<typename T>
-class MuseumObjectGrouper
-{
-public:
-    /**
-     * Group pairs of objects using the scoring function
-     * @param maxCost The maximum cost allowed between vertices to still generate a connection
-     * @param graph The graph to insert into
-     * @param objects The museum objects to source from
-     */
-    static void groupObjects(float maxCost, graph &graph, const vector<MuseumObject> &objects)
-    {
-        auto comparator = T();
-
-        for (const auto &oLeft: objects)
-            for (const auto &oRight: objects)
-            {
-                // Don't compare objects to themselves
-                if (&oLeft == &oRight)
-                    continue;
-
-                auto similarityCost = comparator(oLeft, oRight);
-                if (similarityCost > maxCost)
-                    continue;
-
-                graph.addEdge(oLeft, oRight, similarityCost);
-            }
-    }
-};
-
-/**
- * Use the specified comparison method to insert all pairs in {src} into {dest}
- * @param groupingMethod The method by which to score pairs
- * @param dest The destination graph
- * @param src The source data
- */
-void fillGraph(int groupingMethod, graph &dest, const vector<MuseumObject> &src)
-{
-    switch (groupingMethod)
-    {
-        case 1:
-            MuseumObjectGrouper<MuseumObjectDateComparator>::groupObjects(100, dest, src);
-            break;
-        case 2:
-            MuseumObjectGrouper<MuseumObjectArtistComparator>::groupObjects(2, dest, src);
-            break;
-        case 3:
-            MuseumObjectGrouper<MuseumObjectLocationComparator>::groupObjects(2, dest, src);
-            break;
-        default:
-            return;
-    }
-}
-
 /**
  * Provide a way for MuseumObjects to be printed to an output stream
  * @param os The desired output stream
@@ -88,47 +39,89 @@ int main(int argc, char *argv[])
     cout << "Welcome to The M.E.T.: Museum Exhibit Tool!\n" << endl;
 
     /*
-     * Load all of the objects from the dataset
+     * Parse the command line:
+     * TheMET [--threads N] [--pipeline [--date-workers N]] [--rebuild-snapshot] [--stats] [--materialize] [--knn K]
+     *        [--memory-budget MB [--refuse-over-budget]] [--delta delta.csv]... [--hubs] <dataset.csv>
      */
 
-    vector<MuseumObject> objects;
+    string datasetPath;
+    MuseumObjectLoader::Options loadOptions;
+    loadOptions.threads = defaultThreadCount();
+    bool rebuildSnapshot = false;
+    bool materializeGraph = false;
+    unsigned nearestNeighbors = 0;
+    std::uint64_t memoryBudget = 0;
+    bool refuseOverBudget = false;
+    vector<string> deltaPaths;
+    bool compressCliques = false;
+    IngestStats stats;
+
+    for (size_t i = 1; i < args.size(); ++i)
+    {
+        if (args[i] == "--threads" && i + 1 < args.size())
+            loadOptions.threads = (unsigned) stoul(args[++i]);
+        else if (args[i] == "--pipeline")
+            loadOptions.pipeline = true;
+        else if (args[i] == "--date-workers" && i + 1 < args.size())
+            loadOptions.dateWorkers = (unsigned) stoul(args[++i]);
+        else if (args[i] == "--rebuild-snapshot")
+            rebuildSnapshot = true;
+        else if (args[i] == "--stats")
+            loadOptions.stats = &stats;
+        else if (args[i] == "--materialize")
+            materializeGraph = true;
+        else if (args[i] == "--knn" && i + 1 < args.size())
+            nearestNeighbors = (unsigned) stoul(args[++i]);
+        else if (args[i] == "--memory-budget" && i + 1 < args.size())
+            memoryBudget = stoull(args[++i]) << 20;
+        else if (args[i] == "--refuse-over-budget")
+            refuseOverBudget = true;
+        else if (args[i] == "--delta" && i + 1 < args.size())
+            deltaPaths.push_back(args[++i]);
+        else if (args[i] == "--hubs")
+            compressCliques = true;
+        else
+            datasetPath = args[i];
+    }
+
+    if (datasetPath.empty())
+    {
+        cerr << "Usage: " << args[0] << " [--threads N] [--pipeline [--date-workers N]] [--rebuild-snapshot] [--stats] [--materialize] [--knn K] [--memory-budget MB [--refuse-over-budget]] [--delta delta.csv]... [--hubs] <MetObjects.csv>" << endl;
+        return 1;
+    }
 
     /*
-     * The columns in the CSV dataset are, in order:
-     *
-     * Object Number, Is Highlight, Is Timeline Work, Is Public Domain, Object ID,
-     * Gallery Number, Department, AccessionYear, Object Name, Title, Culture, Period,
-     * Dynasty, Reign, Portfolio, Constituent ID, Artist Role, Artist Prefix, Artist Display Name,
-     * Artist Display Bio, Artist Suffix, Artist Alpha Sort, Artist Nationality, Artist Begin Date,
-     * Artist End Date, Artist Gender, Artist ULAN URL, Artist Wikidata URL, Object Date, Object Begin Date,
-     * Object End Date, Medium, Dimensions, Credit Line, Geography Type, City, State, County,
-     * Country, Region, Subregion, Locale, Locus, Excavation, River, Classification,
-     * Rights and Reproduction, Link Resource, Object Wikidata URL, Metadata Date, Repository,
-     * Tags, Tags AAT URL, Tags Wikidata URL
+     * Load all of the objects from the dataset, or from its snapshot if
+     * the dataset hasn't changed since the snapshot was taken
      */
 
-    io::CSVReader<6, io::trim_chars<' '>, io::double_quote_escape<',', '\"'>> in(args[1]);
-    in.read_header(io::ignore_extra_column, "Object Number", "Is Highlight", "Title", "Artist Display Name", "Country", "Object Date");
+    auto objects = ObjectSnapshot::loadOrBuild(datasetPath, loadOptions, rebuildSnapshot);
+
+    // The stats go to stderr so they don't mix with the exhibit output
+    if (loadOptions.stats)
+        stats.writeJson(cerr);
+
+    /*
+     * Bring the objects up to date with the deltas published since the dataset, in order
+     */
 
-    string objectId, isHighlight, name, artist, country, date;
+    // The objects as they were before the deltas, and the object numbers the deltas changed,
+    // so a graph cached for them can be patched rather than grouped again
+    ObjectTable baseObjects;
+    vector<string> changedIds;
 
-    while (in.read_row(objectId, isHighlight, name, artist, country, date))
+    if (!deltaPaths.empty())
     {
-        if (date.empty() || date == "Date unknown" || date == "date unknown" || date == "date uncertain" || date == "n.d." || date == "unknown")
-            // I'm going to strangle the data entry team at the MET
-            continue;
+        baseObjects.append(objects);
 
-        try
+        ObjectUpdater updater(objects);
+        for (const auto &deltaPath: deltaPaths)
         {
-            // Deserialize the dates into floats
-            auto dateNumeric = MuseumObjectDateComparator::getYear(date);
-            objects.emplace_back(objectId, name, artist, country, dateNumeric);
-        }
-        catch (invalid_argument &e)
-        {
-            // We did everything we could, but alas the date is too poorly
-            // formatted and we must move on
-            continue;
+            auto delta = MuseumObjectLoader::loadDelta(deltaPath);
+            for (const auto &change: delta.changes)
+                changedIds.push_back(change.objectId);
+
+            updater.apply(delta);
         }
     }
 
@@ -165,6 +158,7 @@ int main(int argc, char *argv[])
     cout << "[1] Time period" << endl;
     cout << "[2] Artist" << endl;
     cout << "[3] Location" << endl;
+    cout << "[4] Time period, artist and location" << endl;
 
     cout << endl;
     cout << "Grouping method: " << flush;
@@ -186,33 +180,112 @@ int main(int argc, char *argv[])
      */
 
     /*
-     * 1) Create graph of all works of art
-     */
-
-    graph allWorksOfArt;
-    fillGraph(groupingMethod, allWorksOfArt, objects);
-
-    /*
+     * 1) Relate all works of art in a graph. Unless asked to build the whole
+     * graph up front, or grouping by several criteria at once, the graph
+     * generates the edges of a work when they're needed rather than storing
+     * all of them. With --knn, each work is only related to its K closest
+     * works, which keeps the graph sparse however large the groups are. So
+     * does a --memory-budget that the whole graph wouldn't fit in. With --hubs,
+     * works by the same artist or from the same country are linked through a
+     * hub rather than to each other
+     *
      * 2) Traverse the graph, walking through all works selected by
      * the user
      */
 
     vector<MuseumObject> exhibitItems;
 
-    for (auto const &a: exhibitAnchors)
+    // The pairs of anchors that no chain of related works connects, e.g. works by different
+    // artists when grouping by artist, as those are never related
+    vector<pair<string, string>> unconnectedAnchors;
+
+    auto findExhibitItems = [&](const auto &allWorksOfArt)
     {
-        for (auto const &b: exhibitAnchors)
+        for (auto const &a: exhibitAnchors)
         {
-            if (a == b)
-                continue;
+            for (auto const &b: exhibitAnchors)
+            {
+                if (a == b)
+                    continue;
 
-            auto similarWorks = allWorksOfArt.dijkstra(a, b);
+                auto similarWorks = allWorksOfArt.dijkstra(a, b);
+                // Paths are the same both ways, so only report each pair once
+                if (similarWorks.empty() && find(unconnectedAnchors.begin(), unconnectedAnchors.end(), make_pair(b, a)) == unconnectedAnchors.end())
+                    unconnectedAnchors.emplace_back(a, b);
 
-            for (const auto &work: similarWorks)
-                exhibitItems.push_back(work);
+                for (const auto &work: similarWorks)
+                    exhibitItems.push_back(work);
+            }
+        }
+    };
+
+    // Graphs that are only searched once built are stored compactly, in CSR form, and
+    // cached next to the dataset for later runs (rebuilt along with the snapshot)
+    auto loadOrBuildGraph = [&](csr_graph &worksOfArt, unsigned k)
+    {
+        return GraphFile::loadOrBuild(worksOfArt, datasetPath, {groupingMethod, k}, objects, rebuildSnapshot, [&](csr_graph &built)
+        {
+            if (k > 0)
+                return fillKnnGraph(groupingMethod, built, objects, k, loadOptions.threads);
+
+            // Only the works the deltas changed, and the works related to them, need to be
+            // grouped again if the graph of the works before the deltas is cached
+            csr_graph before;
+            if (!changedIds.empty() && !rebuildSnapshot && GraphFile::load(before, datasetPath, {groupingMethod, 0}, baseObjects)
+                && IncrementalGrouper::patch(groupingMethod, built, before, objects, changedIds))
+                return true;
+
+            fillGraph(groupingMethod, built, objects, loadOptions.threads);
+            return true;
+        });
+    };
+
+    csr_graph sparseWorksOfArt;
+    graph hubWorksOfArt;
+    if (nearestNeighbors > 0 && loadOrBuildGraph(sparseWorksOfArt, nearestNeighbors))
+        findExhibitItems(sparseWorksOfArt);
+    else if (compressCliques && fillHubGraph(groupingMethod, hubWorksOfArt, objects))
+        findExhibitItems(hubWorksOfArt);
+    else if (materializeGraph || !withImplicitGraph(groupingMethod, objects, findExhibitItems))
+    {
+        // Make sure the whole graph fits in the memory budget before building it. If it
+        // doesn't, relate each work to only its closest works instead, or give up
+        auto estimate = GraphEstimator::estimate(groupingMethod, objects);
+        auto estimateMegabytes = (estimate.bytes + (1 << 20) - 1) >> 20;
+
+        if (memoryBudget > 0 && estimate.bytes > memoryBudget)
+        {
+            auto k = refuseOverBudget ? 0 : GraphEstimator::knnWithin(objects, memoryBudget, defaultNearestNeighbors);
+
+            if (k == 0 || !loadOrBuildGraph(sparseWorksOfArt, k))
+            {
+                cerr << "\nRelating the works would take about " << estimateMegabytes << " MB (" << estimate.edges
+                     << " edges), over the memory budget of " << (memoryBudget >> 20) << " MB" << endl;
+                return 1;
+            }
+
+            cerr << "\nRelating the works would take about " << estimateMegabytes << " MB (" << estimate.edges
+                 << " edges), so each is only related to its " << k << " closest works" << endl;
+            findExhibitItems(sparseWorksOfArt);
+        }
+        else
+        {
+            csr_graph allWorksOfArt;
+            loadOrBuildGraph(allWorksOfArt, 0);
+            findExhibitItems(allWorksOfArt);
         }
     }
 
+    if (!unconnectedAnchors.empty())
+    {
+        cerr << endl;
+        for (const auto &[a, b]: unconnectedAnchors)
+            cerr << "No path between the anchors " << a << " and " << b << endl;
+
+        if (exhibitItems.empty())
+            return 1;
+    }
+
     /*
      * 3) Create a minimum spanning tree of the resulting items
      */
@@ -236,22 +309,18 @@ int main(int argc, char *argv[])
     cout << "graph Exhibit {" << endl;
 
     // Print all nodes - node names are "I" + the hash of the artwork name
-    for (const auto &pair: exhibitLayout.getAdjacency())
+    for (const auto &o: exhibitLayout.vertices())
     {
-        MuseumObject o = pair.first;
         cout << "\tI" << std::hash<std::string>()(o.name) << " [shape=box,label=\"" << o.name << "\\nCirca: " << o.date << "\\nAN: " << o.objectId << "\"];" << endl;
     }
 
     // Print all connections, skipping connections we've already printed (i.e. print A-B but skip B-A when we get to it)
     set<ulong> printed;
-    for (const auto &pair: exhibitLayout.getAdjacency())
+    for (const auto &[o, neighbors]: exhibitLayout.adjacency())
     {
-        MuseumObject o = pair.first;
-        map<MuseumObject, float> neighbors = pair.second;
-
         for (const auto &neighbor: neighbors)
         {
-            std::pair<ulong, ulong> h = std::make_pair((ulong) std::hash<std::string>()(o.name), (ulong) std::hash<std::string>()(neighbor.first.name));
+            std::pair<ulong, ulong> h = std::make_pair((ulong) std::hash<std::string>()(o.name), (ulong) std::hash<std::string>()(neighbor.first->name));
 
             if (printed.count(h.first ^ h.second))
                 continue;
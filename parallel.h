@@ -0,0 +1,76 @@
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <exception>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#ifndef THEMET_PARALLEL_H
+#define THEMET_PARALLEL_H
+
+/**
+ * Gets the number of worker threads to use when the user doesn't specify one
+ * @return The number of hardware threads, or 1 if that can't be determined
+ */
+inline unsigned defaultThreadCount()
+{
+    return std::max(1u, std::thread::hardware_concurrency());
+}
+
+/**
+ * Invokes fn(i) for every i in [0, count), handing the indices out in
+ * ascending order to up to {threads} worker threads
+ * @tparam F The work function, callable as fn(std::size_t)
+ * @param count The number of work items
+ * @param threads The maximum number of threads to use
+ * @param fn The work function
+ */
+template<typename F>
+void parallelFor(std::size_t count, unsigned threads, F &&fn)
+{
+    threads = (unsigned) std::min<std::size_t>(std::max(1u, threads), count);
+
+    if (threads <= 1)
+    {
+        for (std::size_t i = 0; i < count; ++i)
+            fn(i);
+        return;
+    }
+
+    std::atomic<std::size_t> next(0);
+    std::exception_ptr error;
+    std::mutex errorLock;
+
+    auto worker = [&]()
+    {
+        try
+        {
+            for (auto i = next++; i < count; i = next++)
+                fn(i);
+        }
+        catch (...)
+        {
+            // Stop handing out work and keep the first failure to rethrow it on the calling thread
+            next = count;
+
+            std::lock_guard<std::mutex> lock(errorLock);
+            if (!error)
+                error = std::current_exception();
+        }
+    };
+
+    std::vector<std::thread> workers;
+    for (unsigned i = 1; i < threads; ++i)
+        workers.emplace_back(worker);
+
+    worker();
+
+    for (auto &t: workers)
+        t.join();
+
+    if (error)
+        std::rethrow_exception(error);
+}
+
+#endif //THEMET_PARALLEL_H
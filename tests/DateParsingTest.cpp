@@ -0,0 +1,73 @@
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include "../MuseumObject.h"
+
+using namespace std;
+
+/**
+ * Checks MuseumObjectDateComparator::getYear against a table of Object Date strings
+ *
+ * Every line of the table is a date, a tab and the year it must parse to, or
+ * "unparseable" if it must not parse. Lines starting with '#' are comments.
+ *
+ * DateParsingTest <object_dates.tsv>
+ */
+int main(int argc, char *argv[])
+{
+    if (argc != 2)
+    {
+        cerr << "Usage: " << argv[0] << " <object_dates.tsv>" << endl;
+        return EXIT_FAILURE;
+    }
+
+    ifstream table(argv[1]);
+    if (!table)
+    {
+        cerr << "Unable to open " << argv[1] << endl;
+        return EXIT_FAILURE;
+    }
+
+    string line;
+    unsigned lineNumber = 0, checked = 0, failed = 0;
+
+    while (getline(table, line))
+    {
+        ++lineNumber;
+        if (line.empty() || line[0] == '#')
+            continue;
+
+        auto tab = line.rfind('\t');
+        if (tab == string::npos)
+        {
+            cerr << argv[1] << ":" << lineNumber << ": missing the expected year" << endl;
+            return EXIT_FAILURE;
+        }
+
+        auto date = line.substr(0, tab);
+        auto expected = line.substr(tab + 1);
+
+        string actual;
+        try
+        {
+            auto year = MuseumObjectDateComparator::getYear(date);
+            actual = expected != "unparseable" && year == stof(expected) ? expected : to_string(year);
+        }
+        catch (exception &)
+        {
+            actual = "unparseable";
+        }
+
+        ++checked;
+        if (actual != expected)
+        {
+            ++failed;
+            cerr << argv[1] << ":" << lineNumber << ": \"" << date << "\" parsed to " << actual << ", expected " << expected << endl;
+        }
+    }
+
+    cout << checked - failed << " of " << checked << " dates parsed as expected" << endl;
+    return failed == 0 && checked > 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,298 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <map>
+#include <random>
+#include <string>
+#include <tuple>
+#include <vector>
+#include "../csr_graph.h"
+#include "../graph.h"
+#include "../implicit_graph.h"
+#include "../IncrementalGrouper.h"
+#include "../MuseumObjectGrouper.h"
+#include "../ObjectDelta.h"
+#include "../ObjectTable.h"
+#include "../ObjectUpdater.h"
+
+using namespace std;
+
+/**
+ * Checks that the groupers fillGraph uses relate exactly the pairs of objects that
+ * scoring every pair with MuseumObjectGrouper does, at the same costs, and that every
+ * kind of graph merges the rows of objects that share an ID the same way. Also checks
+ * that patching a graph after a delta gives the graph grouping the updated objects does
+ *
+ * GroupingTest
+ */
+
+typedef vector<tuple<string, string, float>> EdgeList;
+
+static unsigned failures = 0;
+
+static void check(bool passed, const string &what)
+{
+    if (passed)
+        return;
+
+    ++failures;
+    cerr << "FAILED: " << what << endl;
+}
+
+/**
+ * Makes a table with few artists, countries and dates, so that many objects share them
+ * @param count The number of rows
+ * @param ids The number of distinct object IDs, which the rows take in turn
+ */
+static ObjectTable makeTable(unsigned count, unsigned ids)
+{
+    mt19937 random(20211209);
+    uniform_int_distribution<int> artist(0, 11), country(0, 4), year(-60, 260);
+
+    ObjectTable objects;
+    for (unsigned i = 0; i < count; ++i)
+        objects.add("O" + to_string(i % ids), "Work " + to_string(i), "Artist " + to_string(artist(random)), "Country " + to_string(country(random)), (float) (year(random) * 10));
+
+    return objects;
+}
+
+/**
+ * Lists every directed edge of a graph by the IDs of its ends, in order
+ */
+static EdgeList edgesOf(const csr_graph &graph)
+{
+    EdgeList edges;
+    for (csr_graph::vertex_type v = 0; v < graph.vertexCount(); ++v)
+        graph.forEachNeighbor(v, [&](csr_graph::vertex_type neighbor, float weight)
+        {
+            edges.emplace_back(string(graph.id(v)), string(graph.id(neighbor)), weight);
+        });
+
+    return edges;
+}
+
+/**
+ * Checks that exactly the objects whose dates are within maxCost of each other are
+ * related, at the distance between their dates, without going through the batch kernels
+ */
+static void checkDistances(const string &name, const ObjectTable &objects, float maxCost, const EdgeList &edges)
+{
+    EdgeList expected;
+    for (auto left: objects)
+        for (auto right: objects)
+        {
+            auto distance = fabs(left.date() - right.date());
+            if (left.index() != right.index() && distance <= maxCost)
+                expected.emplace_back(string(left.objectId()), string(right.objectId()), distance);
+        }
+
+    sort(expected.begin(), expected.end());
+    check(edges == expected, name + ": only objects with dates within the maximum cost are related, at their distance");
+}
+
+/**
+ * Lists every directed edge of any kind of graph by the IDs of its ends, in order,
+ * looking its vertices up by the IDs in a table
+ */
+template<typename G>
+static EdgeList edgesById(const G &graph, const ObjectTable &objects)
+{
+    map<string, typename G::vertex_type> vertices;
+    for (auto row: objects)
+        if (auto v = graph.find(string(row.objectId())))
+            vertices.emplace(string(row.objectId()), *v);
+
+    EdgeList edges;
+    for (const auto &[id, v]: vertices)
+        graph.forEachNeighbor(v, [&](typename G::vertex_type neighbor, float weight)
+        {
+            edges.emplace_back(id, string(graph.id(neighbor)), weight);
+        });
+
+    return edges;
+}
+
+/**
+ * Checks that a graph, a csr_graph and an implicit_graph have the same edges for a table
+ * in which several rows share each object ID
+ */
+static void checkDuplicateIds(int groupingMethod, const string &name, const ObjectTable &objects)
+{
+    graph mapGraph;
+    fillGraph(groupingMethod, mapGraph, objects, 1);
+    auto expected = edgesById(mapGraph, objects);
+
+    csr_graph csrGraph;
+    fillGraph(groupingMethod, csrGraph, objects, 1);
+    check(edgesById(csrGraph, objects) == expected, name + ": a csr_graph merges rows with the same ID like a graph");
+
+    withImplicitGraph(groupingMethod, objects, [&](const auto &implicitGraph)
+    {
+        check(edgesById(implicitGraph, objects) == expected, name + ": an implicit_graph merges rows with the same ID like a graph");
+    });
+}
+
+/**
+ * Lists the object each vertex of a graph stands for by its ID and name, in order
+ */
+static vector<pair<string, string>> verticesOf(const csr_graph &graph)
+{
+    vector<pair<string, string>> vertices;
+    for (csr_graph::vertex_type v = 0; v < graph.vertexCount(); ++v)
+    {
+        auto object = graph.object(v);
+        vertices.emplace_back(object.objectId, object.name);
+    }
+
+    return vertices;
+}
+
+/**
+ * Makes a delta that removes, changes and adds objects of a table made by makeTable
+ * @param ids The number of distinct object IDs in the table
+ */
+static ObjectDelta makeDelta(unsigned ids)
+{
+    mt19937 random(20211210);
+    uniform_int_distribution<int> artist(0, 11), country(0, 4), year(-60, 260), id(0, (int) ids - 1);
+
+    ObjectDelta delta;
+    for (unsigned i = 0; i < 30; ++i)
+    {
+        // Every third change adds an object, and the others remove or change an existing one
+        auto objectId = i % 3 == 0 ? "N" + to_string(i) : "O" + to_string(id(random));
+
+        if (i % 3 == 1)
+        {
+            delta.changes.push_back({objectId, {}});
+            continue;
+        }
+
+        delta.changes.push_back({objectId, delta.objects.size()});
+        delta.objects.add(objectId, "Update " + to_string(i), "Artist " + to_string(artist(random)), "Country " + to_string(country(random)), (float) (year(random) * 10));
+    }
+
+    // Change an object twice, which only keeps the second change
+    delta.changes.push_back({"N0", delta.objects.size()});
+    delta.objects.add("N0", "Update again", "Artist 0", "Country 0", 1000);
+
+    return delta;
+}
+
+/**
+ * Checks that patching the graph of a table after a delta gives the same graph as
+ * grouping the updated table again, with the same vertices, objects and edges
+ */
+static void checkPatch(int groupingMethod, const string &name, const ObjectTable &objects, unsigned ids)
+{
+    csr_graph before;
+    fillGraph(groupingMethod, before, objects, 1);
+
+    auto delta = makeDelta(ids);
+    vector<string> changedIds;
+    for (const auto &change: delta.changes)
+        changedIds.push_back(change.objectId);
+
+    ObjectTable after;
+    after.append(objects);
+    ObjectUpdater(after).apply(delta);
+
+    csr_graph patched;
+    check(IncrementalGrouper::patch(groupingMethod, patched, before, after, changedIds), name + ": the graph can be patched");
+
+    csr_graph regrouped;
+    fillGraph(groupingMethod, regrouped, after, 1);
+
+    check(verticesOf(patched) == verticesOf(regrouped), name + ": a patched graph has the vertices of grouping the updated objects");
+    check(edgesOf(patched) == edgesOf(regrouped), name + ": a patched graph has the edges of grouping the updated objects");
+}
+
+template<typename T>
+static EdgeList groupEveryPair(const ObjectTable &objects, float maxCost)
+{
+    csr_graph graph;
+    MuseumObjectGrouper<T>::groupObjects(maxCost, graph, objects);
+    return edgesOf(graph);
+}
+
+static EdgeList fill(int groupingMethod, const ObjectTable &objects, unsigned threads)
+{
+    csr_graph graph;
+    fillGraph(groupingMethod, graph, objects, threads);
+    return edgesOf(graph);
+}
+
+/**
+ * Checks that objects with different keys are never related, and those with equal keys always are
+ */
+template<typename T>
+static void checkGroups(const string &name, const ObjectTable &objects, const EdgeList &edges)
+{
+    const auto &keys = T::keys(objects);
+
+    map<string, typename T::key_type> keyById;
+    map<typename T::key_type, size_t> groupSize;
+    for (auto row: objects)
+    {
+        keyById[string(row.objectId())] = keys[row.index()];
+        ++groupSize[keys[row.index()]];
+    }
+
+    size_t pairs = 0;
+    for (const auto &group: groupSize)
+        pairs += group.second * (group.second - 1);
+
+    bool sameKeys = true;
+    for (const auto &[from, to, weight]: edges)
+        sameKeys = sameKeys && keyById[from] == keyById[to] && weight == 1;
+
+    check(sameKeys, name + ": only objects with equal keys are related, at a cost of 1");
+    check(edges.size() == pairs, name + ": every pair of objects with equal keys is related");
+}
+
+int main()
+{
+    auto objects = makeTable(700, 700);
+
+    check(MuseumObjectArtistComparator()(0, 1) > groupingMaxCost(2), "Objects by different artists are unrelated");
+    check(MuseumObjectLocationComparator()(0, 1) > groupingMaxCost(3), "Objects from different countries are unrelated");
+
+    auto byDate = groupEveryPair<MuseumObjectDateComparator>(objects, dateMaxCost);
+    auto byArtist = groupEveryPair<MuseumObjectArtistComparator>(objects, artistMaxCost);
+    auto byLocation = groupEveryPair<MuseumObjectLocationComparator>(objects, locationMaxCost);
+
+    checkDistances("date", objects, dateMaxCost, byDate);
+    checkGroups<MuseumObjectArtistComparator>("artist", objects, byArtist);
+    checkGroups<MuseumObjectLocationComparator>("location", objects, byLocation);
+
+    for (unsigned threads: {1u, 3u})
+    {
+        auto suffix = " with " + to_string(threads) + " thread(s)";
+        check(fill(1, objects, threads) == byDate, "Sweeping dates relates the pairs that scoring every pair does" + suffix);
+        check(fill(2, objects, threads) == byArtist, "Bucketing artists relates the pairs that scoring every pair does" + suffix);
+        check(fill(3, objects, threads) == byLocation, "Bucketing countries relates the pairs that scoring every pair does" + suffix);
+    }
+
+    // Each ID is shared by up to four rows, which have different keys
+    auto duplicates = makeTable(700, 200);
+    checkDuplicateIds(1, "date", duplicates);
+    checkDuplicateIds(2, "artist", duplicates);
+    checkDuplicateIds(3, "location", duplicates);
+
+    checkPatch(1, "date patch", objects, 700);
+    checkPatch(2, "artist patch", objects, 700);
+    checkPatch(3, "location patch", objects, 700);
+    checkPatch(1, "date patch with shared IDs", duplicates, 200);
+    checkPatch(2, "artist patch with shared IDs", duplicates, 200);
+    checkPatch(3, "location patch with shared IDs", duplicates, 200);
+
+    if (failures != 0)
+    {
+        cerr << failures << " check(s) failed" << endl;
+        return EXIT_FAILURE;
+    }
+
+    cout << "All grouping checks passed" << endl;
+    return EXIT_SUCCESS;
+}